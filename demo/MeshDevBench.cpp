@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "3rdParty/TimeChecker.h"
+
+#include "TriangleMesh.h"
+#include "EdgeStatistics.h"
+#include "MeshNormals.h"
+#include "MeshTopology.h"
+
+namespace
+{
+    // Wavy (n x n) grid with 2 * n * n triangles, no normals.
+    TriangleMesh makeWavyGrid(int n, float phase = 0.0f)
+    {
+        TriangleMesh mesh;
+        mesh.name = "wavyGrid";
+        mesh.vertex.resize(size_t(n + 1) * size_t(n + 1));
+        mesh.index.reserve(size_t(2) * n * n);
+
+        for (int j = 0; j <= n; ++j)
+        {
+            for (int i = 0; i <= n; ++i)
+            {
+                const float x = i / float(n);
+                const float y = j / float(n);
+                const float z = 0.02f * std::sin(12.0f * x + phase) * std::cos(9.0f * y);
+                mesh.vertex[size_t(j) * (n + 1) + i] = make_float3(x, y, z);
+            }
+        }
+        for (int j = 0; j < n; ++j)
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                const uint32_t a = j * (n + 1) + i;
+                const uint32_t b = a + 1;
+                const uint32_t c = a + n + 1;
+                const uint32_t d = c + 1;
+                mesh.index.push_back(make_uint3(a, b, d));
+                mesh.index.push_back(make_uint3(a, d, c));
+            }
+        }
+        return mesh;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t triangles = 10000000;
+    if (argc >= 2)
+        triangles = std::strtoull(argv[1], nullptr, 10);
+
+    const int n = std::max(1, static_cast<int>(std::sqrt(triangles / 2.0)));
+    TriangleMesh mesh = makeWavyGrid(n);
+    std::cout << "Benchmark mesh: " << mesh.vertex.size() << " vertices, " << mesh.index.size() << " triangles\n";
+
+    {
+        const double topoMs = SPIN::TimeCheck([&]() { mesh.topologyCache = SPIN::buildMeshTopology(mesh); });
+        std::cout << "Topology (CSR adjacency):        " << topoMs << " ms, "
+                  << mesh.topologyCache->edges.size() << " unique edges\n";
+    }
+
+    {
+        std::shared_ptr<const SPIN::EdgeLengthStats> stats;
+        const double statsMs = SPIN::TimeCheck([&]() { stats = SPIN::computeEdgeLengthStats(mesh); });
+        std::cout << "Edge length statistics:          " << statsMs << " ms, median " << stats->median << "\n";
+    }
+
+    {
+        std::vector<float3> normals;
+        const double areaMs = SPIN::TimeCheck([&]() { normals = SPIN::computeVertexNormals(mesh, SPIN::NormalWeighting::AREA); });
+        const double angleMs = SPIN::TimeCheck([&]() { normals = SPIN::computeVertexNormals(mesh, SPIN::NormalWeighting::ANGLE); });
+        std::cout << "Vertex normals (area-weighted):  " << areaMs << " ms\n";
+        std::cout << "Vertex normals (angle-weighted): " << angleMs << " ms\n";
+    }
+
+    return 0;
+}
@@ -2,7 +2,9 @@
 #include <cstdio>
 #include <cstring>
 #include <filesystem>
+#include <future>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -17,6 +19,8 @@
 
 #include "Object_t.h"
 #include "GeometryDeviation.h"
+#include "EdgeStatistics.h"
+#include "Registration.h"
 
 using SPIN::Visualizer::Components;
 using SPIN::Visualizer::Stage;
@@ -65,62 +69,6 @@ namespace
 
         return true;
     }
-
-    float computeMedianEdgeLength(const TriangleMesh &mesh)
-    {
-        std::vector<float> edges;
-        edges.reserve(mesh.index.size() * 3);
-
-        for (const uint3 &f : mesh.index)
-        {
-            const float3 &v0 = mesh.vertex[f.x];
-            const float3 &v1 = mesh.vertex[f.y];
-            const float3 &v2 = mesh.vertex[f.z];
-
-            float e0 = length(v1 - v0);
-            float e1 = length(v2 - v1);
-            float e2 = length(v0 - v2);
-
-            edges.push_back(e0);
-            edges.push_back(e1);
-            edges.push_back(e2);
-        }
-
-        if (edges.empty())
-            return 1.0f;
-
-        std::sort(edges.begin(), edges.end());
-        return edges[edges.size() / 2]; // median
-    }
-    float computeMeanEdgeLength(const TriangleMesh &mesh)
-    {
-        std::vector<float> edges;
-        edges.reserve(mesh.index.size() * 3);
-
-        for (const uint3 &f : mesh.index)
-        {
-            const float3 &v0 = mesh.vertex[f.x];
-            const float3 &v1 = mesh.vertex[f.y];
-            const float3 &v2 = mesh.vertex[f.z];
-
-            float e0 = length(v1 - v0);
-            float e1 = length(v2 - v1);
-            float e2 = length(v0 - v2);
-
-            edges.push_back(e0);
-            edges.push_back(e1);
-            edges.push_back(e2);
-        }
-
-        if (edges.empty())
-            return 1.0f;
-        float total = 0.0f;
-        for (const float &e : edges)
-        {
-            total += e;
-        }
-        return total / static_cast<float>(edges.size());
-    }
 }
 
 class MeshDevGUIPanel final : public Components
@@ -181,13 +129,24 @@ public:
                 ImGui::TextUnformatted("Sigma will be computed using Mean Edge Length of Target Mesh.");
             }
 
+            static const char *kDeviationModes[] = {"Closest Point", "Along Normal (CPU only)"};
+            ImGui::Combo("Deviation Mode", &m_deviationMode, kDeviationModes, IM_ARRAYSIZE(kDeviationModes));
+            ImGui::InputFloat("Max Distance (0 = off)", &m_maxDistance, 0.0f, 0.0f, "%.4f");
+            ImGui::InputFloat("CPU Time Budget ms (0 = exact)", &m_timeBudgetMs, 0.0f, 0.0f, "%.0f");
+            ImGui::Checkbox("Align Target to Source (ICP)", &m_alignTarget);
+            if (m_alignTarget)
+                ImGui::Checkbox("Coarse Registration First (any pose)", &m_coarseRegistration);
+
             static const char *kColorMaps[] = {"JET", "Turbo", "Viridis", "Hot", "Cool", "Gray"};
             ImGui::Combo("Color Map", &m_colorMapIndex, kColorMaps, IM_ARRAYSIZE(kColorMaps));
 
             ImGui::Spacing();
             if (ImGui::Button("Run Deviation"))
             {
-                logRunRequest();
+                if (m_cpuRun)
+                    m_statusMessage = "A run is still in progress.";
+                else
+                    logRunRequest();
             }
             ImGui::SameLine();
             if (ImGui::Button("Reset"))
@@ -197,6 +156,19 @@ public:
                 m_statusMessage = "Reset to defaults.";
             }
 
+            if (m_cpuRun)
+            {
+                ImGui::Spacing();
+                ImGui::ProgressBar(m_cpuRun->task.progress(), ImVec2(-1, 0));
+                if (ImGui::Button("Cancel CPU Run"))
+                {
+                    // An alignment in progress finishes first; the runs after it are skipped.
+                    m_cpuRun->cancelled = true;
+                    m_cpuRun->task.cancel();
+                }
+                pollCpuRun();
+            }
+
             ImGui::Spacing();
             ImGui::Separator();
             ImGui::TextWrapped("Status: %s", m_statusMessage.c_str());
@@ -287,8 +259,9 @@ private:
         const std::filesystem::path source(m_sourcePath.data());
         const std::filesystem::path target(m_targetPath.data());
 
-        Object_t objA(source.string());
-        Object_t objB(target.string());
+        // Meshes (and their cached topology / edge statistics) are reused across runs.
+        Object_t &objA = loadCached(source, m_sourceCache);
+        Object_t &objB = loadCached(target, m_targetCache);
         if (objA.model->meshes.empty() || objB.model->meshes.empty())
         {
             m_statusMessage = "Error: Source or Target mesh is empty.";
@@ -298,12 +271,16 @@ private:
 
         TriangleMesh &sourceMesh = *objA.model->meshes[0];
         TriangleMesh &targetMesh = *objB.model->meshes[0];
-        
+
+        // The aligned pose is kept with the cached target (the mesh itself is never moved), so later runs
+        // against the same source start from it.
+        if (m_targetCache.poseSource != source)
+            m_targetCache.pose = SPIN::Affine();
+
+        const auto edgeStats = SPIN::meshEdgeStats(targetMesh);
         float sigma = 1.0f;
-        if(m_sigmaMethod == 0)
-            sigma = computeMedianEdgeLength(targetMesh) * m_sigmaScale;
-        else
-            sigma = computeMeanEdgeLength(targetMesh) * m_sigmaScale;
+        if (edgeStats->count > 0)
+            sigma = ((m_sigmaMethod == 0) ? edgeStats->median : edgeStats->mean) * m_sigmaScale;
 
         std::filesystem::path outputBase(m_outputPath.data());
         if (outputBase.extension().empty())
@@ -311,7 +288,15 @@ private:
             outputBase.replace_extension(".ply");
         }
 
-        auto colorMap = buildColorMap();
+        SPIN::DeviationOptions options;
+        options.mode = (m_deviationMode == 1) ? SPIN::DeviationMode::ALONG_NORMAL : SPIN::DeviationMode::CLOSEST_POINT;
+        if (m_maxDistance > 0.0f)
+            options.maxDistance = m_maxDistance;
+        options.timeBudgetMs = std::max(0.0f, m_timeBudgetMs);
+        options.targetTransform = m_targetCache.pose;
+        // Area-weighted numbers do not depend on how densely the target is tessellated.
+        options.faceDeviation = SPIN::FaceDeviationMode::VERTEX_MEAN;
+
         auto buildOutputPath = [](const std::filesystem::path &base, const char *suffix) {
             std::filesystem::path stem = base;
             stem.replace_extension();
@@ -326,69 +311,240 @@ private:
             return composed;
         };
 
-        auto runMode = [&](const char *label,
-                           auto tagConstant,
-                           const std::filesystem::path &outPath) -> bool {
-            using TagType = typename decltype(tagConstant)::value_type;
-            constexpr TagType tagValue = tagConstant.value;
-            GeometryDeviation<tagValue> geomDev(sourceMesh, targetMesh);
-            geomDev.computeDeviation();
-            const auto &rawDeviations = geomDev.getDeviations();
-            if (rawDeviations.size() != targetMesh.vertex.size())
-            {
-                m_statusMessage = std::string("Deviation size mismatch for ") + label;
-                std::cout << "[MeshDevGUIPanel] " << m_statusMessage << std::endl;
-                return false;
-            }
+        const bool runCpu = m_computeMode == 0 || m_computeMode == 2;
+        bool runGpu = m_computeMode == 1 || m_computeMode == 2;
+        if (runGpu && options.mode != SPIN::DeviationMode::CLOSEST_POINT)
+        {
+            std::cout << "[MeshDevGUIPanel] GPU run skipped: Along Normal mode is CPU only." << std::endl;
+            runGpu = false;
+        }
+        if (!runCpu && !runGpu)
+        {
+            m_statusMessage = "No execution mode selected.";
+            std::cout << "[MeshDevGUIPanel] " << m_statusMessage << std::endl;
+            return;
+        }
 
-            std::vector<float> normalized = rawDeviations;
-            float average = 0.0f;
-            for (float &d : normalized)
+        // Alignment and the CPU run share one host deviation object and run in the background;
+        // draw() polls them, starts the runs once the target is aligned and writes the output.
+        m_cpuRun = std::make_unique<PendingRun>();
+        m_cpuRun->geomDev = std::make_unique<GeometryDeviation<SPIN::ExecTag::HOST>>(sourceMesh, targetMesh);
+        m_cpuRun->geomDev->setOptions(options);
+        m_cpuRun->sourceMesh = &sourceMesh;
+        m_cpuRun->targetMesh = &targetMesh;
+        m_cpuRun->sigma = sigma;
+        m_cpuRun->colorMap = buildColorMap();
+        if (runCpu)
+            m_cpuRun->outPath = buildOutputPath(outputBase, "_cpu");
+        if (runGpu)
+            m_cpuRun->gpuOutPath = buildOutputPath(outputBase, "_gpu");
+
+        if (!m_alignTarget)
+        {
+            startPendingRuns();
+            return;
+        }
+        m_cpuRun->alignedTo = source;
+        GeometryDeviation<SPIN::ExecTag::HOST> *geomDev = m_cpuRun->geomDev.get();
+        const bool coarse = m_coarseRegistration;
+        m_cpuRun->alignment = std::async(std::launch::async, [geomDev, coarse, &sourceMesh, &targetMesh]() {
+            if (coarse)
             {
-                d /= sigma;
-                average += clamp(d, 0.,1.) / static_cast<float>(normalized.size());
+                const SPIN::GlobalRegistrationResult result = SPIN::registerGlobal(sourceMesh, targetMesh);
+                std::cout << "[MeshDevGUIPanel] Coarse registration: " << result.inliers << "/" << result.correspondences
+                          << " inlier matches" << std::endl;
+                SPIN::DeviationOptions seeded = geomDev->getOptions();
+                seeded.targetTransform = result.transform;
+                geomDev->setOptions(seeded);
             }
+            return geomDev->alignTarget();
+        });
+        m_statusMessage = "Aligning target...";
+    }
 
-            std::vector<float3> colors(normalized.size());
-            for (size_t i = 0; i < normalized.size(); ++i)
-            {
-                colors[i] = GeometryDeviationBase::deviation2Color(normalized[i], 256, colorMap);
-            }
+    // Starts the CPU task and the GPU run of m_cpuRun with its (possibly aligned) options.
+    void startPendingRuns()
+    {
+        PendingRun &run = *m_cpuRun;
+        const SPIN::DeviationOptions &options = run.geomDev->getOptions();
+        if (!run.outPath.empty())
+        {
+            run.task = run.geomDev->computeDeviationAsync();
+            m_statusMessage = "CPU deviation running...";
+        }
+        if (!run.gpuOutPath.empty())
+            runGpu(*run.sourceMesh, *run.targetMesh, options, run.sigma, run.colorMap, run.gpuOutPath);
+        if (run.outPath.empty())
+            m_cpuRun.reset();
+    }
 
-            if (!triangleMeshToOBJ(targetMesh, colors, outPath.string()))
-            {
-                m_statusMessage = std::string("Failed to write OBJ for ") + label;
-                std::cout << "[MeshDevGUIPanel] " << m_statusMessage << std::endl;
-                return false;
-            }
+    bool runGpu(const TriangleMesh &sourceMesh,
+                const TriangleMesh &targetMesh,
+                const SPIN::DeviationOptions &options,
+                float sigma,
+                const std::vector<float3> &colorMap,
+                const std::filesystem::path &outPath)
+    {
+        // The device path cannot place meshes on the fly, so it measures a transformed copy.
+        SPIN::DeviationOptions deviceOptions = options;
+        TriangleMesh placedTarget;
+        const bool placed = !options.targetTransform.isIdentity();
+        if (placed)
+        {
+            placedTarget = targetMesh;
+            SPIN::transformMesh(placedTarget, options.targetTransform);
+            deviceOptions.targetTransform = SPIN::Affine();
+        }
+        GeometryDeviation<SPIN::ExecTag::DEVICE> geomDev(sourceMesh, placed ? placedTarget : targetMesh);
+        geomDev.setOptions(deviceOptions);
+        geomDev.computeDeviation();
+        return writeResult("GPU", geomDev, targetMesh, sigma, colorMap, outPath);
+    }
 
-            std::ostringstream oss;
-            //oss << label << " deviation complete in " << elapsedMs << " ms -> " << outPath;
-            oss << label << " sigma : " << sigma << " -> " << outPath << " | Average normalized deviation: " << average;
-            m_statusMessage = oss.str();
+    bool writeResult(const char *label,
+                     const GeometryDeviationBase &geomDev,
+                     const TriangleMesh &targetMesh,
+                     float sigma,
+                     const std::vector<float3> &colorMap,
+                     const std::filesystem::path &outPath)
+    {
+        const auto &rawDeviations = geomDev.getDeviations();
+        if (rawDeviations.size() != targetMesh.vertex.size())
+        {
+            m_statusMessage = std::string("Deviation size mismatch for ") + label;
             std::cout << "[MeshDevGUIPanel] " << m_statusMessage << std::endl;
-            return true;
-        };
+            return false;
+        }
 
-        bool ranSomething = false;
-        if (m_computeMode == 0 || m_computeMode == 2)
+        const SPIN::DeviationStats &stats = geomDev.getStats();
+        std::vector<float3> colors(rawDeviations.size());
+        for (size_t i = 0; i < rawDeviations.size(); ++i)
         {
-            ranSomething |= runMode("CPU",
-                                    std::integral_constant<SPIN::ExecTag, SPIN::ExecTag::HOST>{},
-                                    buildOutputPath(outputBase, "_cpu"));
+            colors[i] = GeometryDeviationBase::deviation2Color(rawDeviations[i] / sigma, 256, colorMap);
         }
-        if (m_computeMode == 1 || m_computeMode == 2)
+
+        if (!triangleMeshToOBJ(targetMesh, colors, outPath.string()))
         {
-            ranSomething |= runMode("GPU",
-                                    std::integral_constant<SPIN::ExecTag, SPIN::ExecTag::DEVICE>{},
-                                    buildOutputPath(outputBase, "_gpu"));
+            m_statusMessage = std::string("Failed to write OBJ for ") + label;
+            std::cout << "[MeshDevGUIPanel] " << m_statusMessage << std::endl;
+            return false;
         }
 
-        if (!ranSomething)
+        std::ostringstream oss;
+        //oss << label << " deviation complete in " << elapsedMs << " ms -> " << outPath;
+        oss << label << " sigma : " << sigma << " -> " << outPath
+            << " | mean " << stats.mean << ", RMS " << stats.rms() << ", std " << stats.stddev()
+            << ", min " << stats.min << ", max " << stats.max
+            << " | P50 " << stats.percentile(50) << ", P95 " << stats.percentile(95) << ", P99 " << stats.percentile(99);
+        if (stats.area.faceCount > 0)
+            oss << " | area-weighted mean " << stats.area.mean << ", RMS " << stats.area.rms()
+                << ", P95 " << stats.area.percentile(95);
+        if (stats.missCount > 0)
+            oss << " | " << stats.missCount << " vertices beyond max distance";
+        if (geomDev.getExactFraction() < 1.0)
+            oss << " | " << geomDev.getExactFraction() * 100.0 << "% exact, rest interpolated";
+        m_statusMessage = oss.str();
+        std::cout << "[MeshDevGUIPanel] " << m_statusMessage << std::endl;
+        return true;
+    }
+
+    struct PendingRun
+    {
+        std::unique_ptr<GeometryDeviation<SPIN::ExecTag::HOST>> geomDev;
+        // Pending target alignment (valid until polled); declared after geomDev so it is joined first.
+        std::future<SPIN::IcpResult> alignment;
+        std::filesystem::path alignedTo;
+        bool cancelled = false;
+        SPIN::DeviationTask task;
+        const TriangleMesh *sourceMesh = nullptr;
+        const TriangleMesh *targetMesh = nullptr;
+        float sigma = 1.0f;
+        std::vector<float3> colorMap;
+        std::filesystem::path outPath;    // CPU output (empty: no CPU run)
+        std::filesystem::path gpuOutPath; // GPU output (empty: no GPU run)
+    };
+
+    void pollCpuRun()
+    {
+        if (m_cpuRun->alignment.valid())
         {
-            m_statusMessage = "No execution mode selected.";
+            if (m_cpuRun->alignment.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                return;
+            try
+            {
+                const SPIN::IcpResult icp = m_cpuRun->alignment.get();
+                m_targetCache.pose = m_cpuRun->geomDev->getOptions().targetTransform;
+                m_targetCache.poseSource = m_cpuRun->alignedTo;
+                std::cout << "[MeshDevGUIPanel] ICP: " << icp.iterations << " iterations, rms " << icp.rms
+                          << (icp.converged ? "" : " (not converged)") << std::endl;
+            }
+            catch (const std::exception &e)
+            {
+                m_statusMessage = std::string("Alignment failed: ") + e.what();
+                std::cout << "[MeshDevGUIPanel] " << m_statusMessage << std::endl;
+                m_cpuRun.reset();
+                return;
+            }
+            if (m_cpuRun->cancelled)
+            {
+                m_statusMessage = "Run cancelled after alignment.";
+                std::cout << "[MeshDevGUIPanel] " << m_statusMessage << std::endl;
+                m_cpuRun.reset();
+                return;
+            }
+            startPendingRuns();
+            return;
+        }
+        if (!m_cpuRun->task.ready())
+            return;
+
+        switch (m_cpuRun->task.status())
+        {
+        case SPIN::TaskStatus::COMPLETED:
+            writeResult("CPU", *m_cpuRun->geomDev, *m_cpuRun->targetMesh, m_cpuRun->sigma, m_cpuRun->colorMap, m_cpuRun->outPath);
+            break;
+        case SPIN::TaskStatus::CANCELLED:
+            m_statusMessage = "CPU run cancelled.";
             std::cout << "[MeshDevGUIPanel] " << m_statusMessage << std::endl;
+            break;
+        default:
+            try
+            {
+                m_cpuRun->task.wait();
+            }
+            catch (const std::exception &e)
+            {
+                m_statusMessage = std::string("CPU run failed: ") + e.what();
+                std::cout << "[MeshDevGUIPanel] " << m_statusMessage << std::endl;
+            }
+            break;
+        }
+        m_cpuRun.reset();
+    }
+
+    struct CachedObject
+    {
+        std::filesystem::path path;
+        std::filesystem::file_time_type writeTime;
+        std::unique_ptr<Object_t> object;
+        // Aligned placement of the mesh against the source at poseSource (identity until aligned).
+        SPIN::Affine pose;
+        std::filesystem::path poseSource;
+    };
+
+    static Object_t &loadCached(const std::filesystem::path &path, CachedObject &cache)
+    {
+        std::error_code ec;
+        const auto writeTime = std::filesystem::last_write_time(path, ec);
+        if (!cache.object || cache.path != path || cache.writeTime != writeTime)
+        {
+            cache.object = std::make_unique<Object_t>(path.string());
+            cache.path = path;
+            cache.writeTime = writeTime;
+            cache.pose = SPIN::Affine();
+            cache.poseSource.clear();
         }
+        return *cache.object;
     }
 
     void setPathBuffer(std::array<char, 520> &buffer, const std::filesystem::path &path)
@@ -438,9 +594,17 @@ private:
     float m_sigmaScale = 1.0f;
     int m_colorMapIndex = 0;
     int m_sigmaMethod = 0; // 0: Median, 1: Mean
+    int m_deviationMode = 0; // 0: Closest Point, 1: Along Normal
+    float m_maxDistance = 0.0f;
+    float m_timeBudgetMs = 0.0f;
+    bool m_alignTarget = false;
+    bool m_coarseRegistration = false;
     std::vector<std::filesystem::path> m_recentSelection;
     std::vector<std::filesystem::path> m_lastDialogResult;
     std::string m_statusMessage;
+    CachedObject m_sourceCache;
+    CachedObject m_targetCache;
+    std::unique_ptr<PendingRun> m_cpuRun;
 };
 
 class FileDialogDemoApplication final : public SPIN::Visualizer::Application
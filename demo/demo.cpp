@@ -6,11 +6,13 @@
 #include "Object_t.h"
 
 #include "GeometryDeviation.h"
+#include "EdgeStatistics.h"
 
 void writeDeviationPLY(
     const TriangleMesh& mesh,
     const std::vector<float>& deviations,
-    const std::string& filename
+    const std::string& filename,
+    float sigma = 1.0f
 )
 {
     if (mesh.vertex.empty() || mesh.index.empty()) {
@@ -27,7 +29,7 @@ void writeDeviationPLY(
 
     std::vector<float3> colors(mesh.vertex.size());
     for (size_t i = 0; i < mesh.vertex.size(); ++i) {
-        float nd = deviations[i];  // 0~1
+        float nd = deviations[i] / sigma;  // 0~1
         nd = clamp(nd, 0.0f, 1.0f);
         colors[i] = GeometryDeviationBase::deviation2Color(nd);
     }
@@ -100,33 +102,6 @@ void writeDeviationPLY(
     plyOut.close();
 }
 
-float computeMedianEdgeLength(const TriangleMesh& mesh)
-{
-    std::vector<float> edges;
-    edges.reserve(mesh.index.size() * 3);
-
-    for (const uint3& f : mesh.index)
-    {
-        const float3 &v0 = mesh.vertex[f.x];
-        const float3 &v1 = mesh.vertex[f.y];
-        const float3 &v2 = mesh.vertex[f.z];
-
-        float e0 = length(v1 - v0);
-        float e1 = length(v2 - v1);
-        float e2 = length(v0 - v2);
-
-        edges.push_back(e0);
-        edges.push_back(e1);
-        edges.push_back(e2);
-    }
-
-    if (edges.empty())
-        return 1.0f;
-
-    std::sort(edges.begin(), edges.end());
-    return edges[edges.size() / 2];        // median
-}
-
 bool compareTwoVector(const std::vector<float>& a, const std::vector<float>& b, float tol = 1e-6f)
 {
     if (a.size() != b.size())
@@ -193,15 +168,18 @@ int main(int argc, char** argv)
         std::cout << "Host and Device deviations DO NOT match!" << std::endl;
     }
     
-    float sigma = computeMedianEdgeLength(*objA.model->meshes[0]);
+    const auto edgeStats = SPIN::meshEdgeStats(*objA.model->meshes[0]);
+    float sigma = (edgeStats->count > 0) ? edgeStats->median : 1.0f;
     std::cout << "Median edge length of source mesh: " << sigma << std::endl;
 
-    //compute deviations/sigma
-    for (auto& d : const_cast<std::vector<float>&>(deviations)) {
-        d /= sigma;
-    }
+    const SPIN::DeviationStats& stats = geomDev.getStats();
+    std::cout << "Deviation stats: mean " << stats.mean << ", RMS " << stats.rms()
+              << ", std " << stats.stddev() << ", min " << stats.min << ", max " << stats.max << std::endl;
+    std::cout << "Deviation percentiles: P50 " << stats.percentile(50) << ", P95 " << stats.percentile(95)
+              << ", P99 " << stats.percentile(99) << " (rank error <= " << stats.quantiles.normalizedRankError() << ")" << std::endl;
 
-    writeDeviationPLY(*objB.model->meshes[0], deviations, outPlyPath.string());
+    // deviations are normalized by sigma while colouring
+    writeDeviationPLY(*objB.model->meshes[0], deviations, outPlyPath.string(), sigma);
 
     {
         // objB의 첫 번째 mesh를 그대로 쓰는게 목적이면, 굳이 복사 안 하고 참조로 써도 됨
@@ -215,7 +193,7 @@ int main(int argc, char** argv)
         for (size_t i = 0; i < outputMesh.vertex.size(); ++i)
         {
             float d = deviations[i];
-            float nd = d; // 보통 0~1 근처로 오도록 조정
+            float nd = d / sigma; // 보통 0~1 근처로 오도록 조정
             colors[i] = GeometryDeviationBase::deviation2Color(nd);
         }
 
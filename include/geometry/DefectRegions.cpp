@@ -0,0 +1,212 @@
+#include "DefectRegions.h"
+#include "HostParallel.h"
+#include "MeshTopology.h"
+
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+namespace
+{
+    constexpr size_t kGrain = 16384;
+
+    // Root of v, halving the path on the way (benign races: every write still points to an ancestor).
+    uint32_t findRoot(std::atomic<uint32_t> *parent, uint32_t v)
+    {
+        for (;;)
+        {
+            uint32_t p = parent[v].load(std::memory_order_relaxed);
+            if (p == v)
+                return v;
+            const uint32_t gp = parent[p].load(std::memory_order_relaxed);
+            if (gp != p)
+                parent[v].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+            v = gp;
+        }
+    }
+
+    // Links the larger root below the smaller, so each component ends at its smallest vertex.
+    void unite(std::atomic<uint32_t> *parent, uint32_t a, uint32_t b)
+    {
+        for (;;)
+        {
+            a = findRoot(parent, a);
+            b = findRoot(parent, b);
+            if (a == b)
+                return;
+            if (a < b)
+                std::swap(a, b);
+            uint32_t expected = a;
+            if (parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed))
+                return;
+        }
+    }
+
+    // Labels the components of the vertices v < n passing inside, connected through mesh edges with both
+    // ends inside: union-find over the edges, then numbering in order of the smallest vertex. Vertices
+    // outside keep their label; returns the inside vertices in ascending order.
+    template <typename Inside>
+    std::vector<uint32_t> labelComponents(const SPIN::MeshTopology &topo, size_t n, const Inside &inside,
+                                          std::vector<uint32_t> &label, size_t &numComponents)
+    {
+        std::unique_ptr<std::atomic<uint32_t>[]> parent(new std::atomic<uint32_t>[n]);
+        SPIN::parallelFor(0, n, kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+                parent[v].store(static_cast<uint32_t>(v), std::memory_order_relaxed);
+        });
+        SPIN::parallelFor(0, topo.edges.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+            {
+                const uint2 edge = topo.edges[i];
+                if (edge.y < n && inside(edge.x) && inside(edge.y))
+                    unite(parent.get(), edge.x, edge.y);
+            }
+        });
+
+        const std::vector<uint32_t> members = SPIN::parallelSelect(n, inside);
+        const std::vector<uint32_t> roots = SPIN::parallelSelect(n, [&](size_t v) {
+            return parent[v].load(std::memory_order_relaxed) == v && inside(v);
+        });
+        SPIN::parallelFor(0, roots.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t r = b; r < e; ++r)
+                label[roots[r]] = static_cast<uint32_t>(r);
+        });
+        SPIN::parallelFor(0, members.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+                label[members[i]] = label[findRoot(parent.get(), members[i])];
+        });
+        numComponents = roots.size();
+        return members;
+    }
+}
+
+namespace SPIN
+{
+    DefectRegions extractDefectRegions(const TriangleMesh &mesh, const std::vector<float> &field,
+                                       const DefectRegionOptions &options)
+    {
+        DefectRegions result;
+        const size_t n = std::min(mesh.vertex.size(), field.size());
+        result.label.assign(mesh.vertex.size(), DefectRegions::kNone);
+        if (n == 0)
+            return result;
+
+        auto outside = [&](size_t v) {
+            const float d = field[v];
+            return std::isfinite(d) && (options.absolute ? std::fabs(d) : d) > options.threshold;
+        };
+        const auto topo = meshTopology(mesh);
+
+        // Components of the out-of-tolerance vertices, numbered in order of their smallest vertex.
+        size_t numComponents = 0;
+        const std::vector<uint32_t> members = labelComponents(*topo, n, outside, result.label, numComponents);
+        std::vector<uint32_t> &label = result.label;
+
+        // Members grouped by component (stable radix sort on the component bits).
+        unsigned componentBits = 1;
+        while ((size_t(1) << componentBits) < numComponents)
+            ++componentBits;
+        std::vector<uint64_t> keys(members.size());
+        parallelFor(0, members.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+                keys[i] = (uint64_t(members[i]) << 32) | label[members[i]];
+        });
+        parallelRadixSort(keys, componentBits);
+        std::vector<size_t> start(numComponents + 1, members.size());
+        parallelFor(0, keys.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+            {
+                const uint32_t c = static_cast<uint32_t>(keys[i]);
+                if (i == 0 || static_cast<uint32_t>(keys[i - 1]) != c)
+                    start[c] = i;
+            }
+        });
+
+        // Per-component statistics; vertex areas are gathered from the incident faces.
+        std::vector<DefectRegion> components(numComponents);
+        parallelFor(0, numComponents, 64, [&](size_t b, size_t e, unsigned) {
+            for (size_t c = b; c < e; ++c)
+            {
+                DefectRegion &region = components[c];
+                double weightedSum = 0.0, valueSum = 0.0;
+                double cx = 0.0, cy = 0.0, cz = 0.0, mx = 0.0, my = 0.0, mz = 0.0;
+                float best = -INFINITY;
+                region.lower = make_float3(INFINITY, INFINITY, INFINITY);
+                region.upper = make_float3(-INFINITY, -INFINITY, -INFINITY);
+                for (size_t i = start[c]; i < start[c + 1]; ++i)
+                {
+                    const uint32_t v = static_cast<uint32_t>(keys[i] >> 32);
+                    const float3 &p = mesh.vertex[v];
+                    const float d = field[v];
+                    double vertexArea = 0.0;
+                    for (const uint32_t *f = topo->facesBegin(v); f != topo->facesEnd(v); ++f)
+                    {
+                        const uint3 t = mesh.index[*f];
+                        vertexArea += length(cross(mesh.vertex[t.y] - mesh.vertex[t.x], mesh.vertex[t.z] - mesh.vertex[t.x])) / 6.0;
+                    }
+                    region.area += vertexArea;
+                    weightedSum += vertexArea * d;
+                    valueSum += d;
+                    cx += vertexArea * p.x;
+                    cy += vertexArea * p.y;
+                    cz += vertexArea * p.z;
+                    mx += p.x;
+                    my += p.y;
+                    mz += p.z;
+                    region.lower = fminf(region.lower, p);
+                    region.upper = fmaxf(region.upper, p);
+                    const float key = options.absolute ? std::fabs(d) : d;
+                    if (key > best)
+                    {
+                        best = key;
+                        region.maxDeviation = d;
+                        region.maxVertex = v;
+                    }
+                }
+                region.vertexCount = start[c + 1] - start[c];
+                const double count = static_cast<double>(region.vertexCount);
+                if (region.area > 0.0)
+                {
+                    region.meanDeviation = weightedSum / region.area;
+                    region.centroid = make_float3(float(cx / region.area), float(cy / region.area), float(cz / region.area));
+                }
+                else
+                {
+                    region.meanDeviation = valueSum / count;
+                    region.centroid = make_float3(float(mx / count), float(my / count), float(mz / count));
+                }
+            }
+        });
+
+        // Keep the regions passing the size filters, largest first (ties by first vertex).
+        std::vector<uint32_t> kept;
+        for (size_t c = 0; c < numComponents; ++c)
+            if (components[c].vertexCount >= options.minVertices && components[c].area >= options.minArea)
+                kept.push_back(static_cast<uint32_t>(c));
+        std::stable_sort(kept.begin(), kept.end(), [&](uint32_t a, uint32_t b) { return components[a].area > components[b].area; });
+        std::vector<uint32_t> remap(numComponents, DefectRegions::kNone);
+        result.regions.reserve(kept.size());
+        for (uint32_t c : kept)
+        {
+            remap[c] = static_cast<uint32_t>(result.regions.size());
+            result.regions.push_back(components[c]);
+        }
+        parallelFor(0, members.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+                label[members[i]] = remap[label[members[i]]];
+        });
+        return result;
+    }
+
+    std::vector<uint32_t> labelMeshComponents(const TriangleMesh &mesh, size_t &componentCount)
+    {
+        std::vector<uint32_t> label(mesh.vertex.size(), DefectRegions::kNone);
+        componentCount = 0;
+        if (mesh.vertex.empty())
+            return label;
+        const auto topo = meshTopology(mesh);
+        labelComponents(*topo, mesh.vertex.size(), [&](size_t v) { return topo->faceDegree(static_cast<uint32_t>(v)) > 0; },
+                        label, componentCount);
+        return label;
+    }
+}
@@ -0,0 +1,863 @@
+#include "DeviationBatch.h"
+#include "DefectRegions.h"
+#include "HostParallel.h"
+#include "MeshNormals.h"
+#include "MeshSimplify.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+    // Source primitive a deviation was measured against (triangle -1 for a miss).
+    struct SourceHit
+    {
+        int triangle = -1;
+        int instance = -1;
+    };
+
+    // Per-vertex deviation query shared by the host code paths.
+    // Queries run in the source frame; distances are scaled back to the measured frame.
+    // Source is HostTriangleBVH or HostSceneBVH.
+    template <typename Source>
+    struct VertexQuery
+    {
+        const Source &bvh;
+        const SPIN::DeviationOptions &options;
+        const std::vector<float3> *normals = nullptr; // required for ALONG_NORMAL
+        SPIN::DeviationFrame frame;
+
+        float operator()(const float3 &targetPoint, size_t vertexIdx, SourceHit *source = nullptr) const
+        {
+            return at(targetPoint, options.mode == SPIN::DeviationMode::ALONG_NORMAL ? (*normals)[vertexIdx] : float3{}, source);
+        }
+
+        // Deviation of a target-frame point with the given (not necessarily unit) normal.
+        float at(const float3 &targetPoint, const float3 &n, SourceHit *source = nullptr) const
+        {
+            const float3 p = frame.point(targetPoint);
+            const float maxDistance = options.maxDistance / frame.sourceScale;
+            if (options.mode == SPIN::DeviationMode::ALONG_NORMAL)
+            {
+                const float len = length(n);
+                if (len > 0.0f)
+                {
+                    const SPIN::RayHit hit = bvh.intersectBothWays(p, frame.direction(n / len), maxDistance);
+                    if (hit.valid())
+                    {
+                        if (source)
+                            *source = {hit.triangle, hit.instance};
+                        return (options.signedDistance ? hit.t : std::fabs(hit.t)) * frame.sourceScale;
+                    }
+                }
+                if (!options.closestPointFallback)
+                    return INFINITY;
+            }
+            const SPIN::ClosestHit hit = bvh.closestPoint(p, maxDistance);
+            if (source)
+                *source = {hit.triangle, hit.instance};
+            // A signed field takes the side of the fallback point, as the ray hits do.
+            if (options.mode == SPIN::DeviationMode::ALONG_NORMAL && options.signedDistance && hit.valid() &&
+                dot(hit.point - p, frame.direction(n)) < 0.0f)
+                return -hit.distance * frame.sourceScale;
+            return hit.distance * frame.sourceScale;
+        }
+    };
+
+    // Material of the source triangle behind a hit (see DeviationOptions::sourceTriangleMaterials).
+    // Without a table every hit takes the materialID of the mesh the BVH was built from.
+    int hitMaterial(const SPIN::HostTriangleBVH &bvh, const SPIN::DeviationOptions &options, const SourceHit &hit)
+    {
+        const std::vector<int> *materials = options.sourceTriangleMaterials.get();
+        if (!materials)
+            return bvh.materialID();
+        return static_cast<size_t>(hit.triangle) < materials->size() ? (*materials)[hit.triangle] : -1;
+    }
+    int hitMaterial(const SPIN::HostSceneBVH &scene, const SPIN::DeviationOptions &, const SourceHit &hit)
+    {
+        return scene.instances()[hit.instance].mesh->materialID;
+    }
+
+    // Every material a hit can report, ascending.
+    std::vector<int> sourceMaterials(const SPIN::HostTriangleBVH &bvh, const SPIN::DeviationOptions &options)
+    {
+        if (!options.sourceTriangleMaterials)
+            return {bvh.materialID()};
+        // Triangles beyond the table report -1 as well.
+        std::vector<int> materials = {-1};
+        // Triangles of one material are usually stored together; only changes are collected.
+        const std::vector<int> &table = *options.sourceTriangleMaterials;
+        for (size_t t = 0; t < table.size(); ++t)
+            if (t == 0 || table[t] != table[t - 1])
+                materials.push_back(table[t]);
+        std::sort(materials.begin(), materials.end());
+        materials.erase(std::unique(materials.begin(), materials.end()), materials.end());
+        return materials;
+    }
+    std::vector<int> sourceMaterials(const SPIN::HostSceneBVH &scene, const SPIN::DeviationOptions &)
+    {
+        std::vector<int> materials;
+        for (const SPIN::SceneInstance &inst : scene.instances())
+            materials.push_back(inst.mesh->materialID);
+        std::sort(materials.begin(), materials.end());
+        materials.erase(std::unique(materials.begin(), materials.end()), materials.end());
+        return materials;
+    }
+
+    // Breakdown accumulators of one query pass (DeviationOptions::breakdownByMaterial / ByComponent).
+    template <typename Source>
+    class BreakdownPass
+    {
+    public:
+        BreakdownPass(const Source &source, const TriangleMesh &target, const SPIN::DeviationOptions &options,
+                      const SPIN::DeviationStats &layout)
+            : m_source(source), m_options(options)
+        {
+            if (options.breakdownByMaterial)
+            {
+                m_result.materials = sourceMaterials(source, options);
+                m_materialStats = std::make_unique<SPIN::DeviationGroupStats>(m_result.materials.size(), layout, SPIN::hostWorkerCount());
+            }
+            if (options.breakdownByComponent)
+            {
+                size_t count = 0;
+                m_result.componentLabel = SPIN::labelMeshComponents(target, count);
+                SPIN::DeviationStats componentLayout = layout;
+                componentLayout.histogram.clear();
+                m_componentStats = std::make_unique<SPIN::DeviationGroupStats>(count, componentLayout, SPIN::hostWorkerCount());
+            }
+        }
+
+        bool active() const { return m_materialStats || m_componentStats; }
+
+        void add(unsigned worker, size_t v, const SourceHit &hit, float d)
+        {
+            if (m_materialStats && hit.triangle >= 0)
+            {
+                const int slot = m_result.materialIndex(hitMaterial(m_source, m_options, hit));
+                if (slot >= 0)
+                    m_materialStats->add(worker, static_cast<uint32_t>(slot), d);
+            }
+            if (m_componentStats && m_result.componentLabel[v] != SPIN::DeviationBreakdown::kNone)
+                m_componentStats->add(worker, m_result.componentLabel[v], d);
+        }
+
+        SPIN::DeviationBreakdown finish()
+        {
+            if (m_materialStats)
+                m_result.byMaterial = m_materialStats->merge();
+            if (m_componentStats)
+                m_result.byComponent = m_componentStats->merge();
+            return std::move(m_result);
+        }
+
+    private:
+        const Source &m_source;
+        const SPIN::DeviationOptions &m_options;
+        SPIN::DeviationBreakdown m_result;
+        std::unique_ptr<SPIN::DeviationGroupStats> m_materialStats;
+        std::unique_ptr<SPIN::DeviationGroupStats> m_componentStats;
+    };
+
+    uint64_t splitMix64(uint64_t x)
+    {
+        x += 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    // Largest (upper) or smallest p with n * KL(k/n || p) <= logTerm: the Chernoff bound on the mean of
+    // n independent Bernoulli draws, exceeded with probability at most exp(-logTerm).
+    double chernoffBound(size_t k, size_t n, double logTerm, bool upper)
+    {
+        auto term = [](double a, double b) { return a > 0.0 ? a * std::log(a / b) : 0.0; };
+        const double q = static_cast<double>(k) / static_cast<double>(n);
+        double lo = upper ? q : 0.0, hi = upper ? 1.0 : q;
+        for (int it = 0; it < 64; ++it)
+        {
+            const double mid = 0.5 * (lo + hi);
+            const bool inside = static_cast<double>(n) * (term(q, mid) + term(1.0 - q, 1.0 - mid)) <= logTerm;
+            if (inside == upper)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        return upper ? hi : lo;
+    }
+
+    uint32_t expandBits10(uint32_t v)
+    {
+        v &= 0x3ff;
+        v = (v | (v << 16)) & 0x030000FF;
+        v = (v | (v << 8)) & 0x0300F00F;
+        v = (v | (v << 4)) & 0x030C30C3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    // Vertices of the query list sorted along a 30-bit Morton curve over their bounds.
+    std::vector<uint32_t> mortonOrder(const TriangleMesh &target, const std::vector<uint32_t> &queries)
+    {
+        const size_t n = queries.size();
+        std::vector<float3> lowers(SPIN::hostWorkerCount(), make_float3(INFINITY, INFINITY, INFINITY));
+        std::vector<float3> uppers(SPIN::hostWorkerCount(), make_float3(-INFINITY, -INFINITY, -INFINITY));
+        SPIN::parallelFor(0, n, 65536, [&](size_t b, size_t e, unsigned worker) {
+            for (size_t i = b; i < e; ++i)
+            {
+                lowers[worker] = fminf(lowers[worker], target.vertex[queries[i]]);
+                uppers[worker] = fmaxf(uppers[worker], target.vertex[queries[i]]);
+            }
+        });
+        float3 lo = lowers[0], hi = uppers[0];
+        for (size_t w = 1; w < lowers.size(); ++w)
+        {
+            lo = fminf(lo, lowers[w]);
+            hi = fmaxf(hi, uppers[w]);
+        }
+        const float3 extent = hi - lo;
+        const float3 scale = make_float3(extent.x > 0.0f ? 1023.0f / extent.x : 0.0f,
+                                         extent.y > 0.0f ? 1023.0f / extent.y : 0.0f,
+                                         extent.z > 0.0f ? 1023.0f / extent.z : 0.0f);
+
+        // Position in the high half, code in the low 30 bits: the stable sort keeps ties in list order.
+        std::vector<uint64_t> keys(n);
+        SPIN::parallelFor(0, n, 65536, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+            {
+                const float3 q = (target.vertex[queries[i]] - lo) * scale;
+                const uint32_t code = (expandBits10(static_cast<uint32_t>(q.x)) << 2) |
+                                      (expandBits10(static_cast<uint32_t>(q.y)) << 1) |
+                                      expandBits10(static_cast<uint32_t>(q.z));
+                keys[i] = (uint64_t(i) << 32) | code;
+            }
+        });
+        SPIN::parallelRadixSort(keys, 30);
+
+        std::vector<uint32_t> curve(n);
+        SPIN::parallelFor(0, n, 65536, [&](size_t b, size_t e, unsigned) {
+            for (size_t k = b; k < e; ++k)
+                curve[k] = queries[keys[k] >> 32];
+        });
+        return curve;
+    }
+
+    // Gives every uncomputed curve position the deviation of the spatially closer of its nearest
+    // computed neighbours along the curve (O(n), parallel over blocks).
+    void fillFromCurveNeighbours(const TriangleMesh &target, const std::vector<uint32_t> &curve,
+                                 const std::vector<uint8_t> &computed, std::vector<float> &devs)
+    {
+        constexpr size_t kNone = std::numeric_limits<size_t>::max();
+        const size_t n = curve.size();
+        const size_t blockSize = std::max<size_t>(4096, (n + SPIN::hostWorkerCount() * 4 - 1) / (SPIN::hostWorkerCount() * 4));
+        const size_t blocks = (n + blockSize - 1) / blockSize;
+
+        // Last and first computed position of every block, then carried across blocks.
+        std::vector<size_t> blockLast(blocks, kNone), blockFirst(blocks, kNone);
+        SPIN::parallelFor(0, n, blockSize, [&](size_t b, size_t e, unsigned) {
+            const size_t blk = b / blockSize;
+            for (size_t k = b; k < e; ++k)
+                if (computed[k])
+                {
+                    if (blockFirst[blk] == kNone)
+                        blockFirst[blk] = k;
+                    blockLast[blk] = k;
+                }
+        });
+        std::vector<size_t> leftCarry(blocks, kNone), rightCarry(blocks, kNone);
+        for (size_t blk = 1; blk < blocks; ++blk)
+            leftCarry[blk] = (blockLast[blk - 1] != kNone) ? blockLast[blk - 1] : leftCarry[blk - 1];
+        for (size_t blk = blocks - 1; blk-- > 0;)
+            rightCarry[blk] = (blockFirst[blk + 1] != kNone) ? blockFirst[blk + 1] : rightCarry[blk + 1];
+
+        SPIN::parallelFor(0, n, blockSize, [&](size_t b, size_t e, unsigned) {
+            const size_t blk = b / blockSize;
+            std::vector<size_t> left(e - b);
+            size_t l = leftCarry[blk];
+            for (size_t k = b; k < e; ++k)
+            {
+                if (computed[k])
+                    l = k;
+                left[k - b] = l;
+            }
+            size_t r = rightCarry[blk];
+            for (size_t k = e; k-- > b;)
+            {
+                if (computed[k])
+                {
+                    r = k;
+                    continue;
+                }
+                const float3 &p = target.vertex[curve[k]];
+                const size_t lk = left[k - b];
+                float best = INFINITY;
+                size_t pick = kNone;
+                for (size_t c : {lk, r})
+                {
+                    if (c == kNone)
+                        continue;
+                    const float3 d = target.vertex[curve[c]] - p;
+                    if (dot(d, d) < best)
+                    {
+                        best = dot(d, d);
+                        pick = c;
+                    }
+                }
+                if (pick != kNone)
+                    devs[curve[k]] = devs[curve[pick]];
+            }
+        });
+    }
+}
+
+namespace SPIN
+{
+    DeviationFrame makeDeviationFrame(const DeviationOptions &options)
+    {
+        DeviationFrame frame;
+        frame.identity = options.targetTransform.isIdentity() && options.sourceTransform.isIdentity();
+        if (frame.identity)
+            return frame;
+
+        float scale = 1.0f;
+        if (!options.sourceTransform.similarityScale(scale))
+            throw std::invalid_argument("Deviation source transform must be rigid up to a uniform scale");
+
+        frame.targetToSource = options.sourceTransform.inverse() * options.targetTransform;
+        frame.sourceToTarget = frame.targetToSource.inverse();
+        frame.sourceScale = scale;
+        return frame;
+    }
+
+    template <typename Source>
+    void evaluateFaceDeviationsOn(const Source &sourceBVH, const TriangleMesh &target, const std::vector<float> &vertexDeviations,
+                                  const DeviationOptions &options, std::vector<float> &faceDeviations,
+                                  const std::vector<uint32_t> *faces)
+    {
+        const size_t numFaces = target.index.size();
+        faceDeviations.resize(numFaces, std::numeric_limits<float>::quiet_NaN());
+        const DeviationFrame frame = makeDeviationFrame(options);
+        const VertexQuery<Source> query{sourceBVH, options, nullptr, frame};
+        const bool centroid = options.faceDeviation == FaceDeviationMode::CENTROID;
+        const size_t count = faces ? faces->size() : numFaces;
+        parallelFor(0, count, centroid ? 1024 : 65536, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+            {
+                const size_t f = faces ? (*faces)[i] : i;
+                const uint3 t = target.index[f];
+                const float d0 = vertexDeviations[t.x], d1 = vertexDeviations[t.y], d2 = vertexDeviations[t.z];
+                if (std::isnan(d0) || std::isnan(d1) || std::isnan(d2))
+                {
+                    faceDeviations[f] = std::numeric_limits<float>::quiet_NaN();
+                    continue;
+                }
+                if (!centroid)
+                {
+                    faceDeviations[f] = (d0 + d1 + d2) / 3.0f;
+                    continue;
+                }
+                const float3 &p0 = target.vertex[t.x], &p1 = target.vertex[t.y], &p2 = target.vertex[t.z];
+                faceDeviations[f] = query.at((p0 + p1 + p2) / 3.0f, cross(p1 - p0, p2 - p0));
+            }
+        });
+    }
+
+    void evaluateFaceDeviations(const HostTriangleBVH &sourceBVH, const TriangleMesh &target,
+                                const std::vector<float> &vertexDeviations, const DeviationOptions &options,
+                                std::vector<float> &faceDeviations, const std::vector<uint32_t> *faces)
+    {
+        evaluateFaceDeviationsOn(sourceBVH, target, vertexDeviations, options, faceDeviations, faces);
+    }
+
+    AreaWeightedStats computeAreaWeightedStats(const TriangleMesh &target, const std::vector<float> &faceDeviations)
+    {
+        const size_t numFaces = std::min(target.index.size(), faceDeviations.size());
+        auto faceArea = [&](size_t f) {
+            const uint3 t = target.index[f];
+            return 0.5 * static_cast<double>(length(cross(target.vertex[t.y] - target.vertex[t.x], target.vertex[t.z] - target.vertex[t.x])));
+        };
+
+        std::vector<AreaWeightedStats> workerStats(hostWorkerCount());
+        parallelFor(0, numFaces, 65536, [&](size_t b, size_t e, unsigned worker) {
+            for (size_t f = b; f < e; ++f)
+                if (!std::isnan(faceDeviations[f]))
+                    workerStats[worker].add(faceDeviations[f], faceArea(f));
+        });
+        AreaWeightedStats stats;
+        for (const auto &ws : workerStats)
+            stats.merge(ws);
+        if (stats.faceCount == 0)
+            return stats;
+
+        // Finite values in order: face index in the high half, order-preserving float bits in the low half.
+        const std::vector<uint32_t> finite = parallelSelect(numFaces, [&](size_t f) { return std::isfinite(faceDeviations[f]); });
+        std::vector<uint64_t> keys(finite.size());
+        parallelFor(0, finite.size(), 65536, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+            {
+                uint32_t bits;
+                std::memcpy(&bits, &faceDeviations[finite[i]], sizeof(bits));
+                bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+                keys[i] = (uint64_t(finite[i]) << 32) | bits;
+            }
+        });
+        parallelRadixSort(keys, 32);
+
+        // k-th percentile: the value where the running area first reaches k% of the total.
+        auto valueOf = [&](size_t i) { return faceDeviations[keys[i] >> 32]; };
+        stats.percentiles[0] = valueOf(0);
+        double running = 0.0;
+        size_t i = 0;
+        for (int k = 1; k <= 100; ++k)
+        {
+            const double goal = stats.area * k / 100.0;
+            while (i + 1 < keys.size() && running + faceArea(keys[i] >> 32) < goal)
+                running += faceArea(keys[i++] >> 32);
+            stats.percentiles[k] = valueOf(i);
+        }
+        stats.percentiles[100] = valueOf(keys.size() - 1);
+        return stats;
+    }
+
+    template <typename Source>
+    DeviationResult evaluateDeviationOn(const Source &sourceBVH, const TriangleMesh &target,
+                                        const DeviationOptions &options, DeviationControl *control)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const DeviationFrame frame = makeDeviationFrame(options);
+        DeviationResult result;
+        result.stats = makeDeviationStats(options, sourceBVH.diagonal() * frame.sourceScale);
+        if (target.vertex.empty())
+            return result;
+
+        // Meshes loaded without normals get them generated on demand.
+        std::vector<float3> generatedNormals;
+        const std::vector<float3> *normals = &target.normal;
+        if (options.mode == DeviationMode::ALONG_NORMAL && target.normal.size() != target.vertex.size())
+        {
+            generatedNormals = computeVertexNormals(target);
+            normals = &generatedNormals;
+        }
+        const VertexQuery<Source> query{sourceBVH, options, normals, frame};
+
+        const bool useRoi = options.roi.type != RegionOfInterest::Type::NONE;
+        std::vector<uint32_t> roiVertices;
+        if (useRoi)
+            roiVertices = selectRoiVertices(target, options.roi);
+
+        const size_t numQueries = useRoi ? roiVertices.size() : target.vertex.size();
+        // Entries that are never queried (outside the ROI, or skipped after a cancel) stay NaN.
+        result.deviations.assign(target.vertex.size(), std::numeric_limits<float>::quiet_NaN());
+        result.queried = numQueries;
+        std::vector<DeviationStats> workerStats(hostWorkerCount(), result.stats);
+        BreakdownPass<Source> breakdown(sourceBVH, target, options, result.stats);
+        if (control)
+            control->total.store(numQueries, std::memory_order_relaxed);
+
+        std::atomic<bool> skipped{false};
+        std::vector<float> &devs = result.deviations;
+        if (options.timeBudgetMs > 0.0f)
+        {
+            const auto deadline = start + std::chrono::duration<double, std::milli>(options.timeBudgetMs);
+            if (!useRoi)
+            {
+                roiVertices.resize(numQueries);
+                parallelFor(0, numQueries, 65536, [&](size_t b, size_t e, unsigned) {
+                    for (size_t i = b; i < e; ++i)
+                        roiVertices[i] = static_cast<uint32_t>(i);
+                });
+            }
+            const std::vector<uint32_t> curve = mortonOrder(target, roiVertices);
+            std::vector<uint8_t> computed(numQueries, 0);
+
+            // Stratified visiting order along the Morton curve: position 0, then the odd multiples of
+            // P/2, P/4, ... (P = next power of two >= n), so every prefix covers the curve evenly.
+            // The first few thousand queries always run so the map is never empty.
+            size_t pow2 = 1;
+            while (pow2 < numQueries)
+                pow2 <<= 1;
+            std::atomic<bool> expired{false};
+            size_t visited = 0;
+            size_t stride = pow2;
+            for (size_t first = 0; stride > 0 && !expired && !skipped; stride >>= 1, first = stride)
+            {
+                const size_t step = (first == 0) ? pow2 : 2 * stride;
+                if (first >= numQueries)
+                    continue;
+                const size_t count = (numQueries - first + step - 1) / step;
+                visited += count;
+                const bool mandatory = visited <= 4096;
+                parallelFor(0, count, 1024, [&](size_t b, size_t e, unsigned worker) {
+                    if (control && control->cancelled())
+                    {
+                        skipped.store(true, std::memory_order_relaxed);
+                        return;
+                    }
+                    if (!mandatory && std::chrono::steady_clock::now() >= deadline)
+                    {
+                        expired.store(true, std::memory_order_relaxed);
+                        return;
+                    }
+                    DeviationStats &acc = workerStats[worker];
+                    for (size_t m = b; m < e; ++m)
+                    {
+                        const size_t k = first + m * step;
+                        const uint32_t v = curve[k];
+                        SourceHit hit;
+                        devs[v] = query(target.vertex[v], v, &hit);
+                        computed[k] = 1;
+                        acc.add(devs[v]);
+                        if (breakdown.active())
+                            breakdown.add(worker, v, hit, devs[v]);
+                    }
+                    if (control)
+                        control->advance(e - b);
+                });
+            }
+
+            if (expired && !skipped)
+                fillFromCurveNeighbours(target, curve, computed, devs);
+        }
+        else
+        {
+            parallelFor(0, numQueries, 4096, [&](size_t b, size_t e, unsigned worker) {
+                if (control && control->cancelled())
+                {
+                    skipped.store(true, std::memory_order_relaxed);
+                    return;
+                }
+                DeviationStats &acc = workerStats[worker];
+                for (size_t i = b; i < e; ++i)
+                {
+                    const size_t v = useRoi ? roiVertices[i] : i;
+                    SourceHit hit;
+                    devs[v] = query(target.vertex[v], v, &hit);
+                    acc.add(devs[v]);
+                    if (breakdown.active())
+                        breakdown.add(worker, v, hit, devs[v]);
+                }
+                if (control)
+                    control->advance(e - b);
+            });
+        }
+
+        for (const auto &ws : workerStats)
+            result.stats.merge(ws);
+        result.exact = static_cast<size_t>(result.stats.count + result.stats.missCount);
+        result.cancelled = skipped.load();
+        result.breakdown = breakdown.finish();
+        if (options.faceDeviation != FaceDeviationMode::NONE && !result.cancelled)
+        {
+            evaluateFaceDeviationsOn(sourceBVH, target, devs, options, result.faceDeviations, nullptr);
+            result.stats.area = computeAreaWeightedStats(target, result.faceDeviations);
+        }
+        return result;
+    }
+
+    DeviationResult evaluateDeviation(const HostTriangleBVH &sourceBVH, const TriangleMesh &target,
+                                      const DeviationOptions &options, DeviationControl *control)
+    {
+        return evaluateDeviationOn(sourceBVH, target, options, control);
+    }
+
+    DeviationResult evaluateDeviation(const HostSceneBVH &sourceScene, const TriangleMesh &target,
+                                      const DeviationOptions &options, DeviationControl *control)
+    {
+        return evaluateDeviationOn(sourceScene, target, options, control);
+    }
+
+    DeviationStats evaluateDeviationAt(const HostTriangleBVH &sourceBVH, const TriangleMesh &target,
+                                       const std::vector<uint32_t> &vertices, const DeviationOptions &options,
+                                       std::vector<float> &deviations)
+    {
+        const DeviationFrame frame = makeDeviationFrame(options);
+        DeviationStats stats = makeDeviationStats(options, sourceBVH.diagonal() * frame.sourceScale);
+        const bool alongNormal = options.mode == DeviationMode::ALONG_NORMAL;
+        const bool targetNormals = target.normal.size() == target.vertex.size();
+        std::vector<float3> listNormals;
+        if (alongNormal && !targetNormals)
+            listNormals = computeVertexNormals(target, vertices);
+        const VertexQuery<HostTriangleBVH> query{sourceBVH, options, nullptr, frame};
+
+        std::vector<DeviationStats> workerStats(hostWorkerCount(), stats);
+        parallelFor(0, vertices.size(), 1024, [&](size_t b, size_t e, unsigned worker) {
+            for (size_t i = b; i < e; ++i)
+            {
+                const uint32_t v = vertices[i];
+                const float3 n = !alongNormal ? float3{} : targetNormals ? target.normal[v] : listNormals[i];
+                deviations[v] = query.at(target.vertex[v], n);
+                workerStats[worker].add(deviations[v]);
+            }
+        });
+        for (const auto &ws : workerStats)
+            stats.merge(ws);
+        return stats;
+    }
+
+    DeviationResult previewDeviation(const TriangleMesh &source, const TriangleMesh &target,
+                                     const DeviationOptions &options, float proxyFraction)
+    {
+        proxyFraction = std::clamp(proxyFraction, 1e-4f, 1.0f);
+        auto proxyTriangles = [&](const TriangleMesh &mesh) {
+            return std::max<size_t>(64, static_cast<size_t>(static_cast<double>(mesh.index.size()) * proxyFraction));
+        };
+        const SimplifiedMesh sourceProxy = clusterSimplify(source, proxyTriangles(source));
+        const SimplifiedMesh targetProxy = clusterSimplify(target, proxyTriangles(target));
+        const HostTriangleBVH proxyBVH(sourceProxy.mesh);
+
+        DeviationOptions proxyOptions = options;
+        proxyOptions.roi = RegionOfInterest();
+        proxyOptions.timeBudgetMs = 0.0f;
+        const DeviationResult proxy = evaluateDeviation(proxyBVH, targetProxy.mesh, proxyOptions);
+
+        // Every full-resolution vertex takes the value of its cluster.
+        DeviationResult result;
+        result.stats = makeDeviationStats(options, proxyBVH.diagonal() * makeDeviationFrame(options).sourceScale);
+        result.deviations.assign(target.vertex.size(), std::numeric_limits<float>::quiet_NaN());
+        std::vector<uint32_t> selection;
+        const bool useRoi = options.roi.type != RegionOfInterest::Type::NONE;
+        if (useRoi)
+            selection = selectRoiVertices(target, options.roi);
+        result.queried = useRoi ? selection.size() : target.vertex.size();
+
+        std::vector<DeviationStats> workerStats(hostWorkerCount(), result.stats);
+        parallelFor(0, result.queried, 16384, [&](size_t b, size_t e, unsigned worker) {
+            for (size_t i = b; i < e; ++i)
+            {
+                const size_t v = useRoi ? selection[i] : i;
+                result.deviations[v] = proxy.deviations[targetProxy.vertexMap[v]];
+                workerStats[worker].add(result.deviations[v]);
+            }
+        });
+        for (const auto &ws : workerStats)
+            result.stats.merge(ws);
+        return result;
+    }
+
+    ToleranceResult checkTolerance(const HostTriangleBVH &sourceBVH, const TriangleMesh &target,
+                                   const ToleranceSpec &spec, const DeviationOptions &options, DeviationControl *control)
+    {
+        ToleranceResult result;
+        const DeviationFrame frame = makeDeviationFrame(options);
+
+        std::vector<uint32_t> population;
+        if (options.roi.type != RegionOfInterest::Type::NONE)
+            population = selectRoiVertices(target, options.roi);
+        else
+            population = parallelSelect(target.vertex.size(), [](size_t) { return true; });
+        const size_t n = population.size();
+        result.population = n;
+        result.verdict = ToleranceVerdict::PASS;
+        if (n == 0)
+            return result;
+
+        std::vector<float3> generatedNormals;
+        const std::vector<float3> *normals = &target.normal;
+        if (options.mode == DeviationMode::ALONG_NORMAL && target.normal.size() != target.vertex.size())
+        {
+            generatedNormals = computeVertexNormals(target);
+            normals = &generatedNormals;
+        }
+        // Queries are bounded by the limit alone (options.maxDistance does not apply), except for normal
+        // rays whose misses would fall back to a closer closest point; those stay unbounded.
+        DeviationOptions queryOptions = options;
+        if (options.mode == DeviationMode::CLOSEST_POINT || !options.closestPointFallback)
+            queryOptions.maxDistance = spec.limit;
+        else
+            queryOptions.maxDistance = INFINITY;
+        const VertexQuery<HostTriangleBVH> query{sourceBVH, queryOptions, normals, frame};
+
+        // Draw weights along the Morton curve (area, or one per vertex when the target has no area).
+        const std::vector<uint32_t> curve = mortonOrder(target, population);
+        std::vector<float> weight;
+        if (spec.areaWeighted)
+            weight = computeVertexAreas(target);
+        std::vector<double> cumulative(n);
+        double total = 0.0;
+        for (size_t k = 0; k < n; ++k)
+            cumulative[k] = (total += weight.empty() ? 1.0 : weight[curve[k]]);
+        if (!(total > 0.0))
+        {
+            weight.clear();
+            for (size_t k = 0; k < n; ++k)
+                cumulative[k] = static_cast<double>(k + 1);
+            total = static_cast<double>(n);
+        }
+        auto weightOf = [&](uint32_t v) { return weight.empty() ? 1.0 : static_cast<double>(weight[v]); };
+
+        // 0 = not queried, 1 = within the limit, 2 = beyond it.
+        std::unique_ptr<std::atomic<uint8_t>[]> state(new std::atomic<uint8_t>[target.vertex.size()]);
+        parallelFor(0, target.vertex.size(), 65536, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+                state[v].store(0, std::memory_order_relaxed);
+        });
+        struct WorkerTally
+        {
+            size_t queried = 0, samples = 0, failedSamples = 0;
+            double failWeight = 0.0, passWeight = 0.0;
+            std::vector<uint32_t> failing;
+        };
+        std::vector<WorkerTally> tally(hostWorkerCount());
+        auto fails = [&](uint32_t v, WorkerTally &acc) {
+            uint8_t s = state[v].load(std::memory_order_relaxed);
+            if (s == 0)
+            {
+                const uint8_t r = std::fabs(query(target.vertex[v], v)) <= spec.limit ? 1 : 2;
+                if (state[v].compare_exchange_strong(s, r, std::memory_order_relaxed))
+                {
+                    ++acc.queried;
+                    if (r == 2)
+                    {
+                        acc.failWeight += weightOf(v);
+                        acc.failing.push_back(v);
+                    }
+                    else
+                    {
+                        acc.passWeight += weightOf(v);
+                    }
+                    s = r;
+                }
+            }
+            return s == 2;
+        };
+        auto collect = [&]() {
+            WorkerTally sum;
+            for (const WorkerTally &acc : tally)
+            {
+                sum.queried += acc.queried;
+                sum.samples += acc.samples;
+                sum.failedSamples += acc.failedSamples;
+                sum.failWeight += acc.failWeight;
+                sum.passWeight += acc.passWeight;
+            }
+            result.queried = sum.queried;
+            result.samples = sum.samples;
+            result.failedSamples = sum.failedSamples;
+            result.knownFail = sum.failWeight / total;
+            result.knownPass = sum.passWeight / total;
+        };
+        auto finish = [&](ToleranceVerdict verdict, bool statistical) {
+            result.verdict = verdict;
+            result.statistical = statistical;
+            for (const WorkerTally &acc : tally)
+                result.failing.insert(result.failing.end(), acc.failing.begin(), acc.failing.end());
+            std::sort(result.failing.begin(), result.failing.end());
+            return result;
+        };
+        if (control)
+            control->total.store(n, std::memory_order_relaxed);
+
+        const size_t strata = std::min<size_t>(n, 4096);
+        const double stratumWeight = total / static_cast<double>(strata);
+        const double delta = std::max(0.0, 1.0 - spec.confidence);
+        for (uint64_t round = 1; result.samples < n; ++round)
+        {
+            std::atomic<bool> skipped{false};
+            parallelFor(0, strata, 64, [&](size_t b, size_t e, unsigned worker) {
+                if (control && control->cancelled())
+                {
+                    skipped.store(true, std::memory_order_relaxed);
+                    return;
+                }
+                WorkerTally &acc = tally[worker];
+                const size_t before = acc.queried;
+                for (size_t s = b; s < e; ++s)
+                {
+                    const uint64_t bits = splitMix64(splitMix64((uint64_t(spec.seed) << 32) ^ round) ^ s);
+                    const double u = (static_cast<double>(s) + static_cast<double>(bits >> 11) * 0x1.0p-53) * stratumWeight;
+                    const size_t k = std::min<size_t>(n - 1, std::upper_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin());
+                    ++acc.samples;
+                    acc.failedSamples += fails(curve[k], acc) ? 1 : 0;
+                }
+                if (control)
+                    control->advance(acc.queried - before);
+            });
+            if (skipped)
+                return finish(ToleranceVerdict::CANCELLED, false);
+            collect();
+
+            // Decided by the queried vertices whatever the rest turn out to be.
+            if (result.knownFail > spec.maxFailFraction)
+                return finish(ToleranceVerdict::FAIL, false);
+            if (1.0 - result.knownPass <= spec.maxFailFraction)
+                return finish(ToleranceVerdict::PASS, false);
+
+            // Sequential test: round r spends delta / (r (r + 1)), split over both sides.
+            if (delta > 0.0)
+            {
+                const double logTerm = std::log(2.0 * static_cast<double>(round) * static_cast<double>(round + 1) / delta);
+                result.upperBound = chernoffBound(result.failedSamples, result.samples, logTerm, true);
+                result.lowerBound = chernoffBound(result.failedSamples, result.samples, logTerm, false);
+                if (result.upperBound <= spec.maxFailFraction)
+                    return finish(ToleranceVerdict::PASS, true);
+                if (result.lowerBound > spec.maxFailFraction)
+                    return finish(ToleranceVerdict::FAIL, true);
+            }
+        }
+
+        // Undecided after as many draws as vertices: query the rest for the exact share.
+        std::atomic<bool> skipped{false};
+        parallelFor(0, n, 1024, [&](size_t b, size_t e, unsigned worker) {
+            if (control && control->cancelled())
+            {
+                skipped.store(true, std::memory_order_relaxed);
+                return;
+            }
+            WorkerTally &acc = tally[worker];
+            const size_t before = acc.queried;
+            for (size_t k = b; k < e; ++k)
+                fails(curve[k], acc);
+            if (control)
+                control->advance(acc.queried - before);
+        });
+        if (skipped)
+            return finish(ToleranceVerdict::CANCELLED, false);
+        collect();
+        result.lowerBound = result.upperBound = result.knownFail;
+        return finish(result.knownFail > spec.maxFailFraction ? ToleranceVerdict::FAIL : ToleranceVerdict::PASS, false);
+    }
+
+    DeviationBatch::DeviationBatch(const TriangleMesh &source, const DeviationOptions &options)
+        : m_bvh(source), m_options(options)
+    {
+    }
+
+    std::vector<DeviationResult> DeviationBatch::run(const std::vector<TriangleMesh> &targets) const
+    {
+        // Each target already spreads its vertices over the whole pool, so targets run back to back.
+        std::vector<DeviationResult> results(targets.size());
+        for (size_t i = 0; i < targets.size(); ++i)
+            results[i] = evaluateDeviation(m_bvh, targets[i], m_options);
+        return results;
+    }
+
+    size_t DeviationBatch::run(const TargetLoader &loader, const ResultCallback &onResult) const
+    {
+        // Double buffering: the loader fills the next mesh while the pool queries the current one.
+        auto loadAsync = [&](size_t index, TriangleMesh &mesh) {
+            return std::async(std::launch::async, [&loader, index, &mesh] { return loader(index, mesh); });
+        };
+
+        TriangleMesh buffers[2];
+        std::future<bool> pending = loadAsync(0, buffers[0]);
+        size_t processed = 0;
+        while (pending.get())
+        {
+            TriangleMesh &current = buffers[processed % 2];
+            TriangleMesh &next = buffers[(processed + 1) % 2];
+            next = TriangleMesh();
+            pending = loadAsync(processed + 1, next);
+
+            DeviationResult result = evaluateDeviation(m_bvh, current, m_options);
+            if (onResult)
+                onResult(processed, current, result);
+            ++processed;
+        }
+        return processed;
+    }
+}
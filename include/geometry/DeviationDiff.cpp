@@ -0,0 +1,158 @@
+#include "DeviationDiff.h"
+#include "HostParallel.h"
+
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+    constexpr size_t kGrain = 65536;
+
+    struct DiffTally
+    {
+        size_t compared = 0, onlyBefore = 0, onlyAfter = 0, worse = 0, better = 0;
+        double sumBefore = 0.0, sumAfter = 0.0, sumDelta = 0.0;
+        double sqBefore = 0.0, sqAfter = 0.0, sqDelta = 0.0;
+        float maxBefore = -INFINITY, maxAfter = -INFINITY, maxIncrease = 0.0f, maxDecrease = 0.0f;
+    };
+}
+
+namespace SPIN
+{
+    DeviationDiff diffDeviations(const TriangleMesh &target, const std::vector<float> &before,
+                                 const std::vector<float> &after, const DeviationDiffOptions &options)
+    {
+        const size_t n = target.vertex.size();
+        if (before.size() != n || after.size() != n)
+            throw std::invalid_argument("Deviation diff fields must have one value per target vertex");
+
+        DeviationDiff diff;
+        diff.delta.assign(n, std::numeric_limits<float>::quiet_NaN());
+        std::vector<DiffTally> tally(hostWorkerCount());
+        parallelFor(0, n, kGrain, [&](size_t b, size_t e, unsigned worker) {
+            DiffTally &acc = tally[worker];
+            for (size_t v = b; v < e; ++v)
+            {
+                float d0 = before[v], d1 = after[v];
+                const bool has0 = std::isfinite(d0), has1 = std::isfinite(d1);
+                if (!has0 || !has1)
+                {
+                    acc.onlyBefore += has0 && !has1;
+                    acc.onlyAfter += has1 && !has0;
+                    continue;
+                }
+                if (options.compareMagnitude)
+                {
+                    d0 = std::fabs(d0);
+                    d1 = std::fabs(d1);
+                }
+                const float delta = d1 - d0;
+                diff.delta[v] = delta;
+                ++acc.compared;
+                acc.worse += delta > options.significance;
+                acc.better += delta < -options.significance;
+                acc.sumBefore += d0;
+                acc.sumAfter += d1;
+                acc.sumDelta += delta;
+                acc.sqBefore += double(d0) * d0;
+                acc.sqAfter += double(d1) * d1;
+                acc.sqDelta += double(delta) * delta;
+                acc.maxBefore = std::max(acc.maxBefore, d0);
+                acc.maxAfter = std::max(acc.maxAfter, d1);
+                acc.maxIncrease = std::max(acc.maxIncrease, delta);
+                acc.maxDecrease = std::max(acc.maxDecrease, -delta);
+            }
+        });
+
+        DiffTally sum;
+        for (const DiffTally &acc : tally)
+        {
+            sum.compared += acc.compared;
+            sum.onlyBefore += acc.onlyBefore;
+            sum.onlyAfter += acc.onlyAfter;
+            sum.worse += acc.worse;
+            sum.better += acc.better;
+            sum.sumBefore += acc.sumBefore;
+            sum.sumAfter += acc.sumAfter;
+            sum.sumDelta += acc.sumDelta;
+            sum.sqBefore += acc.sqBefore;
+            sum.sqAfter += acc.sqAfter;
+            sum.sqDelta += acc.sqDelta;
+            sum.maxBefore = std::max(sum.maxBefore, acc.maxBefore);
+            sum.maxAfter = std::max(sum.maxAfter, acc.maxAfter);
+            sum.maxIncrease = std::max(sum.maxIncrease, acc.maxIncrease);
+            sum.maxDecrease = std::max(sum.maxDecrease, acc.maxDecrease);
+        }
+        DeviationDiffSummary &s = diff.summary;
+        s.compared = sum.compared;
+        s.onlyBefore = sum.onlyBefore;
+        s.onlyAfter = sum.onlyAfter;
+        s.worse = sum.worse;
+        s.better = sum.better;
+        if (sum.compared > 0)
+        {
+            const double count = static_cast<double>(sum.compared);
+            s.meanBefore = sum.sumBefore / count;
+            s.meanAfter = sum.sumAfter / count;
+            s.meanDelta = sum.sumDelta / count;
+            s.rmsBefore = std::sqrt(sum.sqBefore / count);
+            s.rmsAfter = std::sqrt(sum.sqAfter / count);
+            s.rmsDelta = std::sqrt(sum.sqDelta / count);
+            s.maxBefore = sum.maxBefore;
+            s.maxAfter = sum.maxAfter;
+            s.maxIncrease = sum.maxIncrease;
+            s.maxDecrease = sum.maxDecrease;
+        }
+
+        DefectRegionOptions regionOptions;
+        regionOptions.threshold = options.significance;
+        regionOptions.absolute = false;
+        regionOptions.minVertices = options.minRegionVertices;
+        regionOptions.minArea = options.minRegionArea;
+        if (s.worse > 0)
+            diff.worse = extractDefectRegions(target, diff.delta, regionOptions);
+        if (s.better > 0)
+        {
+            std::vector<float> negated(n);
+            parallelFor(0, n, kGrain, [&](size_t b, size_t e, unsigned) {
+                for (size_t v = b; v < e; ++v)
+                    negated[v] = -diff.delta[v];
+            });
+            diff.better = extractDefectRegions(target, negated, regionOptions);
+        }
+        return diff;
+    }
+
+    bool loadDeviationField(const std::string &path, const TriangleMesh &target, std::vector<float> &field,
+                            const std::string &channel)
+    {
+        DeviationSidecar sidecar;
+        if (!readDeviationSidecar(path, sidecar))
+            return false;
+        if (!sidecar.matches(target))
+        {
+            std::cerr << "loadDeviationField: " << path << " was written for a different target topology" << std::endl;
+            return false;
+        }
+        for (size_t c = 0; c < sidecar.names.size(); ++c)
+        {
+            if (sidecar.names[c] == channel)
+            {
+                field = std::move(sidecar.channels[c]);
+                return true;
+            }
+        }
+        std::cerr << "loadDeviationField: " << path << " has no channel '" << channel << "'" << std::endl;
+        return false;
+    }
+
+    bool saveDeviationField(const std::string &path, const TriangleMesh &target, const std::vector<float> &field,
+                            const std::string &channel)
+    {
+        DeviationSidecar sidecar(target);
+        sidecar.set(channel, field);
+        return writeDeviationSidecar(path, sidecar);
+    }
+}
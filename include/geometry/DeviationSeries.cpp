@@ -0,0 +1,97 @@
+#include "DeviationSeries.h"
+#include "HostParallel.h"
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+    constexpr size_t kGrain = 65536;
+}
+
+namespace SPIN
+{
+    void DeviationSeriesAggregator::reset(size_t vertexCount)
+    {
+        m_series = 0;
+        m_count.assign(vertexCount, 0);
+        m_mean.assign(vertexCount, 0.0);
+        m_m2.assign(vertexCount, 0.0);
+        m_min.assign(vertexCount, std::numeric_limits<float>::infinity());
+        m_max.assign(vertexCount, -std::numeric_limits<float>::infinity());
+    }
+
+    void DeviationSeriesAggregator::add(const std::vector<float> &deviations)
+    {
+        if (deviations.size() != m_count.size())
+            throw std::invalid_argument("Deviation series results must have one value per target vertex");
+        parallelFor(0, deviations.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+            {
+                const float d = deviations[v];
+                if (!std::isfinite(d))
+                    continue;
+                const uint32_t n = ++m_count[v];
+                const double delta = d - m_mean[v];
+                m_mean[v] += delta / n;
+                m_m2[v] += delta * (d - m_mean[v]);
+                m_min[v] = std::min(m_min[v], d);
+                m_max[v] = std::max(m_max[v], d);
+            }
+        });
+        ++m_series;
+    }
+
+    template <typename F>
+    std::vector<float> DeviationSeriesAggregator::field(F &&value) const
+    {
+        std::vector<float> out(m_count.size());
+        parallelFor(0, out.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+                out[v] = m_count[v] > 0 ? static_cast<float>(value(v)) : std::numeric_limits<float>::quiet_NaN();
+        });
+        return out;
+    }
+
+    std::vector<float> DeviationSeriesAggregator::count() const
+    {
+        std::vector<float> out(m_count.size());
+        parallelFor(0, out.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+                out[v] = static_cast<float>(m_count[v]);
+        });
+        return out;
+    }
+
+    std::vector<float> DeviationSeriesAggregator::mean() const
+    {
+        return field([&](size_t v) { return m_mean[v]; });
+    }
+
+    std::vector<float> DeviationSeriesAggregator::stddev() const
+    {
+        return field([&](size_t v) { return m_count[v] > 1 ? std::sqrt(m_m2[v] / (m_count[v] - 1)) : 0.0; });
+    }
+
+    std::vector<float> DeviationSeriesAggregator::min() const
+    {
+        return field([&](size_t v) { return m_min[v]; });
+    }
+
+    std::vector<float> DeviationSeriesAggregator::max() const
+    {
+        return field([&](size_t v) { return m_max[v]; });
+    }
+
+    DeviationSidecar DeviationSeriesAggregator::toSidecar(const TriangleMesh &target) const
+    {
+        DeviationSidecar sidecar(target);
+        sidecar.set("count", count());
+        sidecar.set("mean", mean());
+        sidecar.set("stddev", stddev());
+        sidecar.set("min", min());
+        sidecar.set("max", max());
+        return sidecar;
+    }
+}
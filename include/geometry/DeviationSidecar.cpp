@@ -0,0 +1,177 @@
+#include "DeviationSidecar.h"
+#include "HostParallel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+    constexpr char kMagic[8] = {'S', 'P', 'I', 'N', 'D', 'E', 'V', '1'};
+    constexpr uint64_t kFnvOffset = 0xcbf29ce484222325ull;
+    // Bytes of the index array hashed per task; fixed so the hash does not depend on the worker count.
+    constexpr size_t kHashChunk = size_t(1) << 18;
+
+    uint64_t fnv1a(const unsigned char *bytes, size_t size, uint64_t hash)
+    {
+        for (size_t i = 0; i < size; ++i)
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        return hash;
+    }
+
+    template <typename T>
+    void writePod(std::ofstream &out, const T &value)
+    {
+        out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    bool readPod(std::ifstream &in, T &value)
+    {
+        return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+    }
+}
+
+namespace SPIN
+{
+    DeviationSidecar::DeviationSidecar(const TriangleMesh &target)
+        : vertexCount(target.vertex.size()), triangleCount(target.index.size()), topologyHash(meshTopologyHash(target))
+    {
+    }
+
+    void DeviationSidecar::set(const std::string &name, std::vector<float> values)
+    {
+        if (values.size() != vertexCount)
+            throw std::invalid_argument("Sidecar channel '" + name + "' does not have one value per vertex");
+        for (size_t c = 0; c < names.size(); ++c)
+        {
+            if (names[c] == name)
+            {
+                channels[c] = std::move(values);
+                return;
+            }
+        }
+        names.push_back(name);
+        channels.push_back(std::move(values));
+    }
+
+    const std::vector<float> *DeviationSidecar::find(const std::string &name) const
+    {
+        for (size_t c = 0; c < names.size(); ++c)
+            if (names[c] == name)
+                return &channels[c];
+        return nullptr;
+    }
+
+    bool DeviationSidecar::matches(const TriangleMesh &target) const
+    {
+        return vertexCount == target.vertex.size() && triangleCount == target.index.size() &&
+               topologyHash == meshTopologyHash(target);
+    }
+
+    uint64_t meshTopologyHash(const TriangleMesh &mesh)
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(mesh.index.data());
+        const size_t size = mesh.index.size() * sizeof(uint3);
+        const size_t chunks = (size + kHashChunk - 1) / kHashChunk;
+        std::vector<uint64_t> chunkHash(chunks);
+        parallelFor(0, chunks, 1, [&](size_t b, size_t e, unsigned) {
+            for (size_t c = b; c < e; ++c)
+            {
+                const size_t begin = c * kHashChunk;
+                chunkHash[c] = fnv1a(bytes + begin, std::min(kHashChunk, size - begin), kFnvOffset);
+            }
+        });
+        return fnv1a(reinterpret_cast<const unsigned char *>(chunkHash.data()), chunks * sizeof(uint64_t), kFnvOffset);
+    }
+
+    bool writeDeviationSidecar(const std::string &path, const DeviationSidecar &sidecar)
+    {
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+        {
+            std::cerr << "writeDeviationSidecar: cannot open file: " << path << std::endl;
+            return false;
+        }
+        out.write(kMagic, sizeof(kMagic));
+        writePod(out, sidecar.vertexCount);
+        writePod(out, sidecar.triangleCount);
+        writePod(out, sidecar.topologyHash);
+        writePod(out, static_cast<uint32_t>(sidecar.names.size()));
+        for (const std::string &name : sidecar.names)
+        {
+            writePod(out, static_cast<uint32_t>(name.size()));
+            out.write(name.data(), name.size());
+        }
+        for (const std::vector<float> &channel : sidecar.channels)
+            out.write(reinterpret_cast<const char *>(channel.data()), channel.size() * sizeof(float));
+        if (!out)
+        {
+            std::cerr << "writeDeviationSidecar: write failed: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool readDeviationSidecar(const std::string &path, DeviationSidecar &sidecar)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            std::cerr << "readDeviationSidecar: cannot open file: " << path << std::endl;
+            return false;
+        }
+        char magic[sizeof(kMagic)];
+        DeviationSidecar read;
+        uint32_t channelCount = 0;
+        if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+            !readPod(in, read.vertexCount) || !readPod(in, read.triangleCount) || !readPod(in, read.topologyHash) ||
+            !readPod(in, channelCount))
+        {
+            std::cerr << "readDeviationSidecar: not a deviation sidecar: " << path << std::endl;
+            return false;
+        }
+        for (uint32_t c = 0; c < channelCount; ++c)
+        {
+            uint32_t length = 0;
+            if (!readPod(in, length) || length > 4096)
+            {
+                std::cerr << "readDeviationSidecar: corrupt channel table: " << path << std::endl;
+                return false;
+            }
+            std::string name(length, '\0');
+            if (!in.read(&name[0], length))
+            {
+                std::cerr << "readDeviationSidecar: corrupt channel table: " << path << std::endl;
+                return false;
+            }
+            read.names.push_back(std::move(name));
+        }
+        // The channel data must fill the rest of the file (guards the allocation against bad counts).
+        const std::streamoff dataStart = in.tellg();
+        in.seekg(0, std::ios::end);
+        const std::streamoff remaining = in.tellg() - dataStart;
+        in.seekg(dataStart);
+        // A sidecar without channels has no data, whatever its vertex count.
+        if ((channelCount > 0 && read.vertexCount > static_cast<uint64_t>(remaining) / sizeof(float)) ||
+            static_cast<uint64_t>(remaining) != uint64_t(channelCount) * read.vertexCount * sizeof(float))
+        {
+            std::cerr << "readDeviationSidecar: channel data does not match the header: " << path << std::endl;
+            return false;
+        }
+        read.channels.resize(channelCount);
+        for (std::vector<float> &channel : read.channels)
+        {
+            channel.resize(read.vertexCount);
+            if (!in.read(reinterpret_cast<char *>(channel.data()), channel.size() * sizeof(float)))
+            {
+                std::cerr << "readDeviationSidecar: truncated file: " << path << std::endl;
+                return false;
+            }
+        }
+        sidecar = std::move(read);
+        return true;
+    }
+}
@@ -0,0 +1,150 @@
+#include "EdgeStatistics.h"
+#include "HostParallel.h"
+#include "MeshTopology.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    // Level-one buckets of the selection: the high 16 bits of a non-negative float, which order like the value.
+    constexpr unsigned kBucketShift = 16;
+    constexpr size_t kBuckets = size_t(1) << (32 - kBucketShift);
+
+    inline uint32_t lengthBucket(float l)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &l, sizeof(bits));
+        return bits >> kBucketShift;
+    }
+}
+
+namespace SPIN
+{
+    float EdgeLengthStats::percentile(float p) const
+    {
+        if (count == 0)
+            return 0.0f;
+        const float pos = std::clamp(p, 0.0f, 100.0f);
+        const int lo = static_cast<int>(pos);
+        if (lo >= 100)
+            return percentiles[100];
+        const float t = pos - static_cast<float>(lo);
+        return percentiles[lo] + (percentiles[lo + 1] - percentiles[lo]) * t;
+    }
+
+    std::shared_ptr<const EdgeLengthStats> computeEdgeLengthStats(const TriangleMesh &mesh)
+    {
+        auto stats = std::make_shared<EdgeLengthStats>();
+        stats->topology = meshTopology(mesh);
+        const auto &edges = stats->topology->edges;
+        const size_t numEdges = edges.size();
+        stats->count = numEdges;
+        if (numEdges == 0)
+            return stats;
+
+        struct Partial
+        {
+            float min = std::numeric_limits<float>::max();
+            float max = 0.0f;
+            double sum = 0.0;
+        };
+        std::vector<Partial> partials(hostWorkerCount());
+        std::vector<std::vector<uint32_t>> histograms(hostWorkerCount());
+        std::vector<float> lengths(numEdges);
+
+        parallelFor(0, numEdges, 16384, [&](size_t b, size_t e, unsigned worker) {
+            Partial &acc = partials[worker];
+            std::vector<uint32_t> &hist = histograms[worker];
+            if (hist.empty())
+                hist.assign(kBuckets, 0);
+            for (size_t i = b; i < e; ++i)
+            {
+                const float l = length(mesh.vertex[edges[i].y] - mesh.vertex[edges[i].x]);
+                lengths[i] = l;
+                ++hist[lengthBucket(l)];
+                acc.min = std::min(acc.min, l);
+                acc.max = std::max(acc.max, l);
+                acc.sum += l;
+            }
+        });
+
+        Partial total;
+        for (const Partial &p : partials)
+        {
+            total.min = std::min(total.min, p.min);
+            total.max = std::max(total.max, p.max);
+            total.sum += p.sum;
+        }
+        stats->min = total.min;
+        stats->max = total.max;
+        stats->mean = static_cast<float>(total.sum / static_cast<double>(numEdges));
+
+        // Two-level selection: the merged bucket histogram locates every 1% rank, then only the buckets
+        // holding one are gathered and refined with nth_element on shrinking ranges (no full sort).
+        std::vector<size_t> bucketStart(kBuckets + 1, 0);
+        parallelFor(0, kBuckets, 4096, [&](size_t b, size_t e, unsigned) {
+            for (size_t k = b; k < e; ++k)
+                for (const auto &hist : histograms)
+                    if (!hist.empty())
+                        bucketStart[k + 1] += hist[k];
+        });
+        for (size_t k = 0; k < kBuckets; ++k)
+            bucketStart[k + 1] += bucketStart[k];
+
+        std::array<size_t, 101> ranks;
+        std::array<uint32_t, 101> rankBucket;
+        std::vector<size_t> gatherStart(kBuckets + 1, 0); // offsets of the target buckets in the gathered array
+        std::vector<uint8_t> target(kBuckets, 0);
+        for (int k = 0; k <= 100; ++k)
+        {
+            ranks[k] = std::min(numEdges - 1, static_cast<size_t>(k * (numEdges - 1) / 100.0 + 0.5));
+            rankBucket[k] = static_cast<uint32_t>(std::upper_bound(bucketStart.begin(), bucketStart.end(), ranks[k]) -
+                                                  bucketStart.begin() - 1);
+            target[rankBucket[k]] = 1;
+        }
+        for (size_t k = 0; k < kBuckets; ++k)
+            gatherStart[k + 1] = gatherStart[k] + (target[k] ? bucketStart[k + 1] - bucketStart[k] : 0);
+
+        const std::vector<uint32_t> gathered =
+            parallelSelect(numEdges, [&](size_t i) { return target[lengthBucket(lengths[i])] != 0; });
+        std::vector<float> selected(gathered.size());
+        std::vector<size_t> cursor(gatherStart.begin(), gatherStart.end() - 1);
+        for (uint32_t i : gathered)
+            selected[cursor[lengthBucket(lengths[i])]++] = lengths[i];
+
+        // Ranks ascend, so each nth_element continues from the previous one inside the same bucket.
+        auto first = selected.begin();
+        uint32_t firstBucket = rankBucket[0];
+        for (int k = 0; k <= 100; ++k)
+        {
+            const uint32_t bucket = rankBucket[k];
+            if (bucket != firstBucket)
+            {
+                first = selected.begin() + gatherStart[bucket];
+                firstBucket = bucket;
+            }
+            auto nth = selected.begin() + gatherStart[bucket] + (ranks[k] - bucketStart[bucket]);
+            std::nth_element(first, nth, selected.begin() + gatherStart[bucket + 1]);
+            stats->percentiles[k] = *nth;
+            first = nth;
+        }
+
+        // The 50% rank is numEdges / 2, the same element the old sort-based median picked.
+        stats->median = stats->percentiles[50];
+        return stats;
+    }
+
+    std::shared_ptr<const EdgeLengthStats> meshEdgeStats(const TriangleMesh &mesh)
+    {
+        std::shared_ptr<const EdgeLengthStats> stats = std::atomic_load(&mesh.edgeStatsCache);
+        if (!stats || stats->topology != meshTopology(mesh))
+        {
+            stats = computeEdgeLengthStats(mesh);
+            std::atomic_store(&mesh.edgeStatsCache, stats);
+        }
+        return stats;
+    }
+}
@@ -1,10 +1,15 @@
 #include "GeometryDeviation.h"
+#include "DeviationBatch.h"
+#include "DefectRegions.h"
+#include "HostParallel.h"
 #include "3rdParty/CUDABuffer.h"
 
 #include "cuBQL/bvh.h"
 #include "cuBQL/builder/cuda.h"
 #include "cuBQL/queries/triangleData/closestPointOnAnyTriangle.h"
 
+#include <stdexcept>
+
 #define CUBQL_GPU_BUILDER_IMPLEMENTATION 1
 
 using cuBQL::divRoundUp;
@@ -26,7 +31,8 @@ __global__ void computeTrianglesAndBoxes(const float3* vertices, const uint3* in
     boxes[idx] = triangles[idx].bounds();
 }
 
-__global__ void runQueries(cuBQL::bvh3f trianglesBVH, const cuBQL::Triangle *triangles, const float3* queryPoints, float* outDeviations, size_t numQueriues){
+// Vertices with no source triangle within maxDistance report INFINITY, as on the host path.
+__global__ void runQueries(cuBQL::bvh3f trianglesBVH, const cuBQL::Triangle *triangles, const float3* queryPoints, float* outDeviations, size_t numQueriues, float maxDistance){
     size_t idx = blockIdx.x * blockDim.x + threadIdx.x;
     if (idx >= numQueriues) return;
 
@@ -35,7 +41,8 @@ __global__ void runQueries(cuBQL::bvh3f trianglesBVH, const cuBQL::Triangle *tri
     cuBQL::triangles::CPAT cpat;
     cpat.runQuery(triangles, trianglesBVH, queryPoint);
 
-    outDeviations[idx] = sqrtf(cpat.sqrDist);
+    const float distance = sqrtf(cpat.sqrDist);
+    outDeviations[idx] = (distance <= maxDistance) ? distance : INFINITY;
 }
 
 void GeometryDeviation<SPIN::ExecTag::DEVICE>::computeDeviation() const
@@ -43,6 +50,17 @@ void GeometryDeviation<SPIN::ExecTag::DEVICE>::computeDeviation() const
     if (sourceMesh.vertex.empty() || sourceMesh.index.empty() || targetMesh.vertex.empty())
         return;
 
+    if (options.mode != SPIN::DeviationMode::CLOSEST_POINT)
+        throw std::runtime_error("DEVICE deviation supports CLOSEST_POINT mode only");
+    if (options.roi.type != SPIN::RegionOfInterest::Type::NONE)
+        throw std::runtime_error("DEVICE deviation does not support a region of interest");
+    if (!options.targetTransform.isIdentity() || !options.sourceTransform.isIdentity())
+        throw std::runtime_error("DEVICE deviation does not support mesh transforms");
+    if (options.faceDeviation == SPIN::FaceDeviationMode::CENTROID)
+        throw std::runtime_error("DEVICE deviation supports VERTEX_MEAN face deviations only");
+    if (options.breakdownByMaterial)
+        throw std::runtime_error("DEVICE deviation does not report source primitives for a material breakdown");
+
     CUDABuffer d_boxes;
     d_boxes.alloc(sizeof(cuBQL::box3f) * sourceMesh.index.size());
     CUDABuffer d_triangles;
@@ -75,10 +93,53 @@ void GeometryDeviation<SPIN::ExecTag::DEVICE>::computeDeviation() const
         (const cuBQL::Triangle*)d_triangles.d_pointer(),
         (const float3*)d_queryPoints.d_pointer(),
         (float*)d_deviations.d_pointer(),
-        numQueries);
+        numQueries,
+        options.maxDistance);
     deviations.resize(numQueries);
     d_deviations.download(deviations.data(), numQueries);
 
+    // Statistics are accumulated on the host from the downloaded array.
+    float3 lower = sourceMesh.vertex[0], upper = sourceMesh.vertex[0];
+    for (const float3 &v : sourceMesh.vertex)
+    {
+        lower = fminf(lower, v);
+        upper = fmaxf(upper, v);
+    }
+    const SPIN::DeviationStats layout = emptyStats(length(upper - lower));
+    std::vector<SPIN::DeviationStats> workerStats(SPIN::hostWorkerCount(), layout);
+    // Component statistics are gathered in the same pass (no histogram, as on the host path).
+    breakdown = SPIN::DeviationBreakdown();
+    size_t numComponents = 0;
+    if (options.breakdownByComponent)
+        breakdown.componentLabel = SPIN::labelMeshComponents(targetMesh, numComponents);
+    SPIN::DeviationStats componentLayout = layout;
+    componentLayout.histogram.clear();
+    SPIN::DeviationGroupStats componentStats(numComponents, componentLayout, SPIN::hostWorkerCount());
+    SPIN::parallelFor(0, deviations.size(), 65536, [&](size_t b, size_t e, unsigned worker) {
+        for (size_t i = b; i < e; ++i)
+        {
+            workerStats[worker].add(deviations[i]);
+            if (options.breakdownByComponent && breakdown.componentLabel[i] != SPIN::DeviationBreakdown::kNone)
+                componentStats.add(worker, breakdown.componentLabel[i], deviations[i]);
+        }
+    });
+    stats = layout;
+    exactFraction = 1.0;
+    for (const auto &ws : workerStats)
+        stats.merge(ws);
+    if (options.breakdownByComponent)
+        breakdown.byComponent = componentStats.merge();
+    if (options.faceDeviation == SPIN::FaceDeviationMode::VERTEX_MEAN)
+    {
+        // Vertex means never query the source, so no host BVH is needed.
+        SPIN::evaluateFaceDeviations(SPIN::HostTriangleBVH(), targetMesh, deviations, options, faceDeviations);
+        stats.area = SPIN::computeAreaWeightedStats(targetMesh, faceDeviations);
+    }
+    else
+    {
+        faceDeviations.clear();
+    }
+
     cuBQL::cuda::free(triangleBVH);
     d_boxes.free();
     d_triangles.free();
@@ -1,51 +1,413 @@
 #include "GeometryDeviation.h"
+#include "DeviationBatch.h"
+#include "HostParallel.h"
+#include "HostTriangleBVH.h"
+#include "MeshTopology.h"
 
-#include "cuBQL/bvh.h"
-#include "cuBQL/builder/cpu.h"
-#include "cuBQL/queries/pointData/findClosest.h"
-#include "cuBQL/queries/triangleData/closestPointOnAnyTriangle.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <memory>
 
 void GeometryDeviation<SPIN::ExecTag::HOST>::computeDeviation() const
+{
+    run(nullptr);
+}
+
+SPIN::DeviationTask GeometryDeviation<SPIN::ExecTag::HOST>::computeDeviationAsync(std::function<void(SPIN::TaskStatus)> onComplete) const
+{
+    waitForAsyncRun();
+    auto control = std::make_shared<SPIN::DeviationControl>();
+    auto busy = std::make_shared<std::atomic<bool>>(true);
+    std::shared_future<SPIN::TaskStatus> future =
+        std::async(std::launch::async, [this, control, busy, onComplete]() {
+            SPIN::TaskStatus status = SPIN::TaskStatus::COMPLETED;
+            try
+            {
+                if (!run(control.get()))
+                    status = SPIN::TaskStatus::CANCELLED;
+            }
+            catch (...)
+            {
+                busy->store(false);
+                if (onComplete)
+                    onComplete(SPIN::TaskStatus::FAILED);
+                throw;
+            }
+            busy->store(false);
+            if (onComplete)
+                onComplete(status);
+            return status;
+        }).share();
+    asyncRun = future;
+    asyncBusy = busy;
+    return SPIN::DeviationTask(control, future);
+}
+
+void GeometryDeviation<SPIN::ExecTag::HOST>::waitForAsyncRun() const
+{
+    // The flag is cleared once the results are stored, so calls from onComplete do not wait on themselves.
+    if (asyncBusy && asyncBusy->load())
+        asyncRun.wait();
+}
+
+SPIN::DeviationTask GeometryDeviation<SPIN::ExecTag::HOST>::computeDeviationProgressive(SPIN::DeviationResult &preview, float proxyFraction,
+                                                                                     std::function<void(SPIN::TaskStatus)> onComplete) const
+{
+    waitForAsyncRun();
+    preview = SPIN::previewDeviation(sourceMesh, targetMesh, options, proxyFraction);
+    return computeDeviationAsync(std::move(onComplete));
+}
+
+// Returns false when the run was cancelled before every vertex was queried.
+bool GeometryDeviation<SPIN::ExecTag::HOST>::run(SPIN::DeviationControl *control) const
 {
     if (sourceMesh.vertex.empty() || sourceMesh.index.empty() || targetMesh.vertex.empty())
+        return true;
+    const auto start = std::chrono::steady_clock::now();
+    const SPIN::DeviationFrame frame = SPIN::makeDeviationFrame(options);
+
+    // With an ROI only the selected target vertices are queried, and source triangles that
+    // cannot hold any of their results are culled before the BVH build.
+    const bool useRoi = options.roi.type != SPIN::RegionOfInterest::Type::NONE;
+    std::vector<uint32_t> roiVertices;
+    if (useRoi)
+        roiVertices = SPIN::selectRoiVertices(targetMesh, options.roi);
+
+    // A full BVH from an earlier run (or refit by updateSource) is reused. A cancel before the build
+    // skips it; the query pass below then skips every chunk.
+    const bool canCull = options.mode == SPIN::DeviationMode::CLOSEST_POINT || std::isfinite(options.maxDistance);
+    const bool cancelled = control && control->cancelled();
+    const bool cull = !cancelled && useRoi && canCull;
+    std::shared_ptr<SPIN::HostTriangleBVH> bvh = sourceBVH;
+    if (cull)
+    {
+        bvh = std::make_shared<SPIN::HostTriangleBVH>();
+        float3 lo, hi;
+        SPIN::closestPointCullBox(sourceMesh, targetMesh, roiVertices, options.maxDistance / frame.sourceScale, lo, hi,
+                                  frame.targetToSource);
+        bvh->build(sourceMesh, SPIN::cullTriangles(sourceMesh, lo, hi));
+    }
+    else if (!bvh || sourceBVHCulled)
+    {
+        bvh = std::make_shared<SPIN::HostTriangleBVH>();
+        if (!cancelled)
+            bvh->build(sourceMesh);
+    }
+    if (!cancelled)
+    {
+        sourceBVH = bvh;
+        sourceBVHCulled = cull;
+    }
+
+    // The time budget covers the whole run, BVH build included.
+    SPIN::DeviationOptions queryOptions = options;
+    if (options.timeBudgetMs > 0.0f)
+    {
+        const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        queryOptions.timeBudgetMs = std::max(1e-3f, options.timeBudgetMs - elapsed.count());
+    }
+
+    SPIN::DeviationResult result = SPIN::evaluateDeviation(*bvh, targetMesh, queryOptions, control);
+    stats = std::move(result.stats);
+    exactFraction = result.exactFraction();
+    setDeviation(result.deviations);
+    faceDeviations = std::move(result.faceDeviations);
+    breakdown = std::move(result.breakdown);
+    lastRunComplete = !result.cancelled && result.exact == result.queried;
+    return !result.cancelled;
+}
+
+void GeometryDeviation<SPIN::ExecTag::HOST>::updateSource(const TriangleMesh &deformedSource)
+{
+    // A running task traverses the BVH that is refitted in place below.
+    waitForAsyncRun();
+    const bool sameTopology = deformedSource.index.size() == sourceMesh.index.size() &&
+                              std::memcmp(deformedSource.index.data(), sourceMesh.index.data(),
+                                          sourceMesh.index.size() * sizeof(uint3)) == 0;
+    sourceMesh = deformedSource;
+    // Results of the previous source no longer apply to incremental target updates.
+    lastRunComplete = false;
+    if (!sameTopology || sourceBVHCulled)
+    {
+        sourceBVH.reset();
         return;
+    }
+    if (sourceBVH)
+        sourceBVH->update(sourceMesh, options.refitInflationLimit);
+}
 
-    std::vector<cuBQL::box3f> boxes(sourceMesh.index.size());
-    std::vector<cuBQL::Triangle> triangles(sourceMesh.index.size());
+const SPIN::HostTriangleBVH &GeometryDeviation<SPIN::ExecTag::HOST>::fullSourceBVH() const
+{
+    if (!sourceBVH || sourceBVHCulled)
+    {
+        sourceBVH = std::make_shared<SPIN::HostTriangleBVH>(sourceMesh);
+        sourceBVHCulled = false;
+    }
+    return *sourceBVH;
+}
 
-    for (int i = 0; i < sourceMesh.index.size(); i++)
+SPIN::IcpResult GeometryDeviation<SPIN::ExecTag::HOST>::alignTarget(const SPIN::IcpOptions &icp)
+{
+    waitForAsyncRun();
+    // ICP runs in the source frame; the result goes back through the source placement.
+    const SPIN::DeviationFrame frame = SPIN::makeDeviationFrame(options);
+    SPIN::IcpResult result = SPIN::alignIcp(fullSourceBVH(), sourceMesh, targetMesh, icp, frame.targetToSource);
+    options.targetTransform = options.sourceTransform * result.transform;
+    // Every target vertex moved; previous deviations no longer apply.
+    lastRunComplete = false;
+    return result;
+}
+
+void GeometryDeviation<SPIN::ExecTag::HOST>::updateDeviation(TriangleMesh &editedTarget)
+{
+    waitForAsyncRun();
+    const size_t oldCount = targetMesh.vertex.size();
+    const size_t newCount = editedTarget.vertex.size();
+    std::vector<uint2> ranges;
+    ranges.swap(editedTarget.dirtyRanges);
+
+    // Removed vertices renumber the rest, and interpolated or skipped values were never in the stats.
+    // Group statistics would need the previous hit of every re-queried vertex, so breakdowns rerun.
+    const bool breakdownRequested = options.breakdownByMaterial || options.breakdownByComponent;
+    if (!lastRunComplete || !sourceBVH || deviations.size() != oldCount || newCount < oldCount || breakdownRequested)
     {
-        uint3 idx = sourceMesh.index[i];
-        float3 v0 = sourceMesh.vertex[idx.x];
-        float3 v1 = sourceMesh.vertex[idx.y];
-        float3 v2 = sourceMesh.vertex[idx.z];
+        targetMesh = editedTarget;
+        computeDeviation();
+        return;
+    }
 
-        triangles[i] = cuBQL::Triangle{cuBQL::vec3f{v0.x, v0.y, v0.z},
-                                       cuBQL::vec3f{v1.x, v1.y, v1.z},
-                                       cuBQL::vec3f{v2.x, v2.y, v2.z}};
+    std::vector<uint32_t> moved;
+    for (const uint2 &r : ranges)
+        for (uint32_t v = r.x; v < std::min<size_t>(r.y, oldCount); ++v)
+            moved.push_back(v);
+    std::sort(moved.begin(), moved.end());
+    moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
 
-        boxes[i] = triangles[i].bounds();
+    // Bring the cached target up to date in O(edit): moved positions are copied and appended vertices
+    // appended. The index is copied only when the connectivity changed (index edits drop the edited
+    // mesh's topology cache, appended vertices outdate it); afterwards both meshes share one topology.
+    auto sync = [&](auto &dst, const auto &src) {
+        if (src.size() != newCount || dst.size() != oldCount)
+        {
+            dst = src;
+            return;
+        }
+        for (uint32_t v : moved)
+            dst[v] = src[v];
+        dst.insert(dst.end(), src.begin() + oldCount, src.end());
+    };
+    // Positions before the edit, for the area the touched faces had.
+    std::vector<float3> movedFrom(moved.size());
+    for (size_t i = 0; i < moved.size(); ++i)
+        movedFrom[i] = targetMesh.vertex[moved[i]];
+    sync(targetMesh.vertex, editedTarget.vertex);
+    sync(targetMesh.normal, editedTarget.normal);
+    sync(targetMesh.texcoord, editedTarget.texcoord);
+    const bool sameConnectivity = newCount == oldCount && editedTarget.index.size() == targetMesh.index.size() &&
+                                  editedTarget.topologyCache && editedTarget.topologyCache == targetMesh.topologyCache;
+    if (!sameConnectivity)
+    {
+        targetMesh.index = editedTarget.index;
+        targetMesh.topologyCache = SPIN::meshTopology(editedTarget);
     }
+    if (!moved.empty() || newCount > oldCount)
+        targetMesh.edgeStatsCache.reset();
+
+    std::vector<uint32_t> dirty = moved;
+    for (size_t v = oldCount; v < newCount; ++v)
+        dirty.push_back(static_cast<uint32_t>(v));
+
+    // Moving a vertex turns the normals of its neighbours.
+    if (options.mode == SPIN::DeviationMode::ALONG_NORMAL && !dirty.empty())
+    {
+        const auto topology = SPIN::meshTopology(targetMesh);
+        const size_t count = dirty.size();
+        for (size_t i = 0; i < count; ++i)
+            dirty.insert(dirty.end(), topology->neighborsBegin(dirty[i]), topology->neighborsEnd(dirty[i]));
+        std::sort(dirty.begin(), dirty.end());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+    }
+    if (dirty.empty())
+        return;
+
+    // Edited vertices may leave the box the culled BVH was built for.
+    fullSourceBVH();
+
+    // New values share the histogram layout of the current statistics.
+    SPIN::DeviationOptions queryOptions = options;
+    queryOptions.histogramRange = stats.histogramMax;
+    const SPIN::DeviationStats layout = SPIN::makeDeviationStats(queryOptions, sourceBVH->diagonal());
+
+    // A complete run left NaN exactly outside the ROI (and on the appended vertices).
+    std::vector<SPIN::DeviationStats> removed(SPIN::hostWorkerCount(), layout);
+    SPIN::parallelFor(0, dirty.size(), 4096, [&](size_t b, size_t e, unsigned worker) {
+        for (size_t i = b; i < e; ++i)
+            if (dirty[i] < oldCount && !std::isnan(deviations[dirty[i]]))
+                removed[worker].add(deviations[dirty[i]]);
+    });
+
+    std::vector<uint32_t> roiSelection;
+    if (options.roi.type == SPIN::RegionOfInterest::Type::VERTICES)
+        roiSelection = SPIN::selectRoiVertices(targetMesh, options.roi);
+    auto inRoi = [&](uint32_t v) {
+        if (options.roi.type == SPIN::RegionOfInterest::Type::VERTICES)
+            return std::binary_search(roiSelection.begin(), roiSelection.end(), v);
+        return options.roi.contains(targetMesh.vertex[v]);
+    };
+
+    // Dirty vertices outside the ROI become NaN; the rest are re-queried in place.
+    deviations.resize(newCount, std::numeric_limits<float>::quiet_NaN());
+    const std::vector<uint32_t> queryIdx = SPIN::parallelSelect(dirty.size(), [&](size_t i) { return inRoi(dirty[i]); });
+    std::vector<uint32_t> queries(queryIdx.size());
+    for (size_t i = 0; i < queryIdx.size(); ++i)
+        queries[i] = dirty[queryIdx[i]];
+    for (uint32_t v : dirty)
+        deviations[v] = std::numeric_limits<float>::quiet_NaN();
+    const SPIN::DeviationStats added = SPIN::evaluateDeviationAt(*sourceBVH, targetMesh, queries, queryOptions, deviations);
 
-    cuBQL::bvh3f triangleBVH;
-    cuBQL::cpuBuilder(triangleBVH, boxes.data(), boxes.size(), cuBQL::BuildConfig());
+    for (const auto &r : removed)
+        stats.subtract(r);
+    stats.merge(added);
+    refreshStaleStats();
 
-    std::vector<float> devs;
-    devs.reserve(targetMesh.vertex.size());
+    // Faces touching a re-queried vertex, plus appended faces; everything after index removals.
+    if (options.faceDeviation != SPIN::FaceDeviationMode::NONE)
+    {
+        const size_t oldFaces = faceDeviations.size();
+        const size_t newFaces = targetMesh.index.size();
+        if (newFaces < oldFaces)
+        {
+            SPIN::evaluateFaceDeviations(*sourceBVH, targetMesh, deviations, options, faceDeviations);
+            stats.area = SPIN::computeAreaWeightedStats(targetMesh, faceDeviations);
+            return;
+        }
+        const auto topology = SPIN::meshTopology(targetMesh);
+        std::vector<uint32_t> faces;
+        for (uint32_t v : dirty)
+            faces.insert(faces.end(), topology->facesBegin(v), topology->facesEnd(v));
+        for (size_t f = oldFaces; f < newFaces; ++f)
+            faces.push_back(static_cast<uint32_t>(f));
+        std::sort(faces.begin(), faces.end());
+        faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
 
-    for (auto &vt : targetMesh.vertex)
+        // Same connectivity: the touched faces leave the area statistics with their old value and area
+        // and come back with the new ones. Otherwise the index was copied in full and so are the stats.
+        auto position = [&](uint32_t v, bool before) {
+            if (before)
+            {
+                const auto it = std::lower_bound(moved.begin(), moved.end(), v);
+                if (it != moved.end() && *it == v)
+                    return movedFrom[it - moved.begin()];
+            }
+            return targetMesh.vertex[v];
+        };
+        auto faceStats = [&](bool before) {
+            SPIN::AreaWeightedStats acc;
+            for (uint32_t f : faces)
+            {
+                if (f >= faceDeviations.size() || std::isnan(faceDeviations[f]))
+                    continue;
+                const uint3 t = targetMesh.index[f];
+                const float3 p0 = position(t.x, before);
+                acc.add(faceDeviations[f], 0.5 * static_cast<double>(length(cross(position(t.y, before) - p0, position(t.z, before) - p0))));
+            }
+            return acc;
+        };
+        SPIN::AreaWeightedStats removedArea;
+        if (sameConnectivity)
+            removedArea = faceStats(true);
+        SPIN::evaluateFaceDeviations(*sourceBVH, targetMesh, deviations, options, faceDeviations, &faces);
+        if (!sameConnectivity)
+        {
+            stats.area = SPIN::computeAreaWeightedStats(targetMesh, faceDeviations);
+            return;
+        }
+        const SPIN::AreaWeightedStats addedArea = faceStats(false);
+        stats.area.subtract(removedArea);
+        stats.area.merge(addedArea);
+        stats.area.staleArea += removedArea.area + addedArea.area;
+        refreshStaleAreaStats();
+    }
+}
+
+// Area-weighted counterpart of refreshStaleStats: min/max are rescanned when a removed face may have
+// held them, and the percentile table is rebuilt once the changed area could move a percentile by
+// more than its 1% step.
+void GeometryDeviation<SPIN::ExecTag::HOST>::refreshStaleAreaStats() const
+{
+    SPIN::AreaWeightedStats &area = stats.area;
+    if (area.staleArea > 0.01 * area.area)
     {
-        cuBQL::vec3f queryPoint = {vt.x, vt.y, vt.z};
+        area = SPIN::computeAreaWeightedStats(targetMesh, faceDeviations);
+        return;
+    }
+    if (!area.extremaStale)
+        return;
 
-        cuBQL::triangles::CPAT cpat;
-        cpat.runQuery(triangles.data(), triangleBVH, queryPoint);
+    const unsigned workers = SPIN::hostWorkerCount();
+    std::vector<float> mins(workers, std::numeric_limits<float>::infinity());
+    std::vector<float> maxs(workers, -std::numeric_limits<float>::infinity());
+    SPIN::parallelFor(0, faceDeviations.size(), 65536, [&](size_t b, size_t e, unsigned worker) {
+        for (size_t f = b; f < e; ++f)
+        {
+            const float d = faceDeviations[f];
+            if (!std::isfinite(d))
+                continue;
+            mins[worker] = std::min(mins[worker], d);
+            maxs[worker] = std::max(maxs[worker], d);
+        }
+    });
+    area.min = *std::min_element(mins.begin(), mins.end());
+    area.max = *std::max_element(maxs.begin(), maxs.end());
+    area.extremaStale = false;
+}
 
-        devs.push_back(sqrtf(cpat.sqrDist));
+// Rescans what subtract() could not keep exact: min/max, and the sketch once the stale values
+// could shift a rank by more than its own error bound.
+void GeometryDeviation<SPIN::ExecTag::HOST>::refreshStaleStats() const
+{
+    const unsigned workers = SPIN::hostWorkerCount();
+    const bool rescanExtrema = stats.extremaStale;
+    const bool rebuildSketch = static_cast<double>(stats.staleQuantileCount) >
+                               stats.quantiles.normalizedRankError() * static_cast<double>(stats.count);
+    if (!rescanExtrema && !rebuildSketch)
+        return;
+
+    std::vector<float> mins(workers, std::numeric_limits<float>::infinity());
+    std::vector<float> maxs(workers, -std::numeric_limits<float>::infinity());
+    std::vector<SPIN::QuantileSketch> sketches(workers, SPIN::QuantileSketch(stats.quantiles.k(), stats.quantiles.exact()));
+    SPIN::parallelFor(0, deviations.size(), 65536, [&](size_t b, size_t e, unsigned worker) {
+        for (size_t i = b; i < e; ++i)
+        {
+            const float d = deviations[i];
+            if (!std::isfinite(d))
+                continue;
+            mins[worker] = std::min(mins[worker], d);
+            maxs[worker] = std::max(maxs[worker], d);
+            if (rebuildSketch)
+                sketches[worker].add(d);
+        }
+    });
+
+    if (rescanExtrema)
+    {
+        stats.min = *std::min_element(mins.begin(), mins.end());
+        stats.max = *std::max_element(maxs.begin(), maxs.end());
+        stats.extremaStale = false;
+    }
+    if (rebuildSketch)
+    {
+        for (unsigned w = 1; w < workers; ++w)
+            sketches[0].merge(sketches[w]);
+        stats.quantiles = std::move(sketches[0]);
+        stats.staleQuantileCount = 0;
     }
-    setDeviation(devs);
 }
 
 const std::vector<float> &GeometryDeviation<SPIN::ExecTag::HOST>::getDeviations() const
 {
     return deviations;
-}
\ No newline at end of file
+}
@@ -0,0 +1,270 @@
+#include "HostTriangleBVH.h"
+#include "HostParallel.h"
+
+#include "cuBQL/builder/cpu.h"
+#include "cuBQL/traversal/rayQueries.h"
+
+namespace
+{
+    inline cuBQL::vec3f toVec3f(const float3 &v) { return cuBQL::vec3f{v.x, v.y, v.z}; }
+
+    // Two-sided Moller-Trumbore; returns t, or -1 when the line misses the triangle.
+    inline float rayTriangle(const cuBQL::vec3f &org, const cuBQL::vec3f &dir, const cuBQL::Triangle &tri)
+    {
+        const cuBQL::vec3f e1 = tri.b - tri.a;
+        const cuBQL::vec3f e2 = tri.c - tri.a;
+        const cuBQL::vec3f p = cross(dir, e2);
+        const float det = dot(e1, p);
+        if (std::fabs(det) < 1e-20f)
+            return -1.0f;
+        const float invDet = 1.0f / det;
+        const cuBQL::vec3f s = org - tri.a;
+        const float u = dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f)
+            return -1.0f;
+        const cuBQL::vec3f q = cross(s, e1);
+        const float v = dot(dir, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f)
+            return -1.0f;
+        return dot(e2, q) * invDet;
+    }
+
+    inline float halfArea(const cuBQL::box3f &b)
+    {
+        const float dx = b.upper.x - b.lower.x;
+        const float dy = b.upper.y - b.lower.y;
+        const float dz = b.upper.z - b.lower.z;
+        return (dx < 0.0f) ? 0.0f : dx * dy + dy * dz + dz * dx;
+    }
+}
+
+namespace SPIN
+{
+    void HostTriangleBVH::build(const TriangleMesh &mesh)
+    {
+        release();
+        buildPrims(mesh, mesh.index.size());
+    }
+
+    void HostTriangleBVH::build(const TriangleMesh &mesh, const std::vector<uint32_t> &triangleSubset)
+    {
+        release();
+        m_subset = triangleSubset;
+        buildPrims(mesh, m_subset.size());
+    }
+
+    void HostTriangleBVH::buildPrims(const TriangleMesh &mesh, size_t numTri)
+    {
+        m_materialID = mesh.materialID;
+        if (mesh.vertex.empty() || numTri == 0)
+        {
+            m_subset.clear();
+            return;
+        }
+
+        m_triangles.resize(numTri);
+        std::vector<cuBQL::box3f> boxes(numTri);
+        std::vector<float3> lowers(hostWorkerCount(), m_lower);
+        std::vector<float3> uppers(hostWorkerCount(), m_upper);
+
+        parallelFor(0, numTri, 16384, [&](size_t b, size_t e, unsigned worker) {
+            float3 lo = lowers[worker];
+            float3 hi = uppers[worker];
+            for (size_t i = b; i < e; ++i)
+            {
+                const uint3 idx = mesh.index[meshTriangle(static_cast<uint32_t>(i))];
+                const float3 &v0 = mesh.vertex[idx.x];
+                const float3 &v1 = mesh.vertex[idx.y];
+                const float3 &v2 = mesh.vertex[idx.z];
+                m_triangles[i] = cuBQL::Triangle{toVec3f(v0), toVec3f(v1), toVec3f(v2)};
+                boxes[i] = m_triangles[i].bounds();
+                lo = fminf(lo, fminf(v0, fminf(v1, v2)));
+                hi = fmaxf(hi, fmaxf(v0, fmaxf(v1, v2)));
+            }
+            lowers[worker] = lo;
+            uppers[worker] = hi;
+        });
+        for (size_t w = 0; w < lowers.size(); ++w)
+        {
+            m_lower = fminf(m_lower, lowers[w]);
+            m_upper = fmaxf(m_upper, uppers[w]);
+        }
+
+        cuBQL::cpuBuilder(m_bvh, boxes.data(), static_cast<uint32_t>(numTri), cuBQL::BuildConfig());
+        m_built = true;
+        m_indexCount = mesh.index.size();
+        buildLevels();
+        m_builtCost = surfaceAreaCost();
+    }
+
+    void HostTriangleBVH::buildLevels()
+    {
+        // Breadth-first pass: nodes grouped by depth so a level can be refitted in parallel.
+        m_levelOffsets.assign(1, 0);
+        m_levelNodes.clear();
+        m_levelNodes.reserve(m_bvh.numNodes);
+        m_levelNodes.push_back(0);
+        size_t begin = 0;
+        while (begin < m_levelNodes.size())
+        {
+            const size_t end = m_levelNodes.size();
+            m_levelOffsets.push_back(static_cast<uint32_t>(end));
+            for (size_t i = begin; i < end; ++i)
+            {
+                const auto &node = m_bvh.nodes[m_levelNodes[i]];
+                if (node.admin.count == 0)
+                {
+                    m_levelNodes.push_back(static_cast<uint32_t>(node.admin.offset));
+                    m_levelNodes.push_back(static_cast<uint32_t>(node.admin.offset + 1));
+                }
+            }
+            begin = end;
+        }
+    }
+
+    float HostTriangleBVH::surfaceAreaCost() const
+    {
+        if (!m_built)
+            return 0.0f;
+        // SAH-style cost relative to the root: internal nodes weigh 1, leaves their primitive count.
+        double cost = 0.0;
+        for (uint32_t i = 0; i < m_bvh.numNodes; ++i)
+        {
+            const auto &node = m_bvh.nodes[i];
+            cost += static_cast<double>(halfArea(node.bounds)) * (node.admin.count ? node.admin.count : 1);
+        }
+        const float rootArea = halfArea(m_bvh.nodes[0].bounds);
+        return rootArea > 0.0f ? static_cast<float>(cost / rootArea) : 0.0f;
+    }
+
+    bool HostTriangleBVH::refit(const TriangleMesh &mesh)
+    {
+        if (!m_built || mesh.index.size() != m_indexCount)
+            return false;
+
+        const size_t numTri = m_triangles.size();
+        parallelFor(0, numTri, 16384, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+            {
+                const uint3 idx = mesh.index[meshTriangle(static_cast<uint32_t>(i))];
+                m_triangles[i] = cuBQL::Triangle{toVec3f(mesh.vertex[idx.x]), toVec3f(mesh.vertex[idx.y]), toVec3f(mesh.vertex[idx.z])};
+            }
+        });
+
+        // Deepest level first: every node reads only finished children or its own primitives.
+        for (size_t level = m_levelOffsets.size() - 1; level-- > 0;)
+        {
+            const size_t b = m_levelOffsets[level];
+            const size_t e = m_levelOffsets[level + 1];
+            parallelFor(b, e, 1024, [&](size_t cb, size_t ce, unsigned) {
+                for (size_t i = cb; i < ce; ++i)
+                {
+                    auto &node = m_bvh.nodes[m_levelNodes[i]];
+                    cuBQL::box3f bounds;
+                    if (node.admin.count == 0)
+                    {
+                        bounds.extend(m_bvh.nodes[node.admin.offset].bounds);
+                        bounds.extend(m_bvh.nodes[node.admin.offset + 1].bounds);
+                    }
+                    else
+                    {
+                        for (uint32_t j = 0; j < node.admin.count; ++j)
+                            bounds.extend(m_triangles[m_bvh.primIDs[node.admin.offset + j]].bounds());
+                    }
+                    node.bounds = bounds;
+                }
+            });
+        }
+
+        const cuBQL::box3f &root = m_bvh.nodes[0].bounds;
+        m_lower = make_float3(root.lower.x, root.lower.y, root.lower.z);
+        m_upper = make_float3(root.upper.x, root.upper.y, root.upper.z);
+        return true;
+    }
+
+    HostTriangleBVH::UpdateKind HostTriangleBVH::update(const TriangleMesh &mesh, float inflationLimit)
+    {
+        if (refit(mesh) && surfaceAreaCost() <= m_builtCost * inflationLimit)
+            return UpdateKind::REFIT;
+
+        std::vector<uint32_t> subset = m_subset;
+        if (subset.empty())
+            build(mesh);
+        else
+            build(mesh, subset);
+        return UpdateKind::REBUILD;
+    }
+
+    void HostTriangleBVH::release()
+    {
+        if (m_built)
+            cuBQL::cpu::freeBVH(m_bvh);
+        m_bvh = cuBQL::bvh3f{};
+        m_built = false;
+        m_triangles.clear();
+        m_subset.clear();
+        m_levelOffsets.clear();
+        m_levelNodes.clear();
+        m_indexCount = 0;
+        m_builtCost = 0.0f;
+        m_materialID = -1;
+        m_lower = make_float3(INFINITY, INFINITY, INFINITY);
+        m_upper = make_float3(-INFINITY, -INFINITY, -INFINITY);
+    }
+
+    ClosestHit HostTriangleBVH::closestPoint(const float3 &p, float maxDistance) const
+    {
+        ClosestHit hit;
+        if (!m_built)
+            return hit;
+
+        cuBQL::triangles::CPAT cpat;
+        cpat.runQuery(m_triangles.data(), m_bvh, toVec3f(p), maxDistance);
+        if (cpat.triangleIdx < 0)
+            return hit;
+
+        hit.distance = sqrtf(cpat.sqrDist);
+        hit.triangle = meshTriangle(static_cast<uint32_t>(cpat.triangleIdx));
+        hit.point = make_float3(cpat.P.x, cpat.P.y, cpat.P.z);
+        return hit;
+    }
+
+    RayHit HostTriangleBVH::intersect(const float3 &origin, const float3 &dir, float maxDistance) const
+    {
+        RayHit hit;
+        if (!m_built)
+            return hit;
+
+        cuBQL::ray3f ray;
+        ray.origin = toVec3f(origin);
+        ray.direction = toVec3f(dir);
+        ray.tMin = 0.0f;
+        ray.tMax = maxDistance;
+
+        auto onPrim = [&](uint32_t primID) -> float {
+            const float t = rayTriangle(ray.origin, ray.direction, m_triangles[primID]);
+            if (t >= 0.0f && t <= ray.tMax)
+            {
+                ray.tMax = t;
+                hit.t = t;
+                hit.triangle = meshTriangle(primID);
+            }
+            return ray.tMax;
+        };
+        cuBQL::shrinkingRayQuery::forEachPrim(onPrim, m_bvh, ray);
+        return hit;
+    }
+
+    RayHit HostTriangleBVH::intersectBothWays(const float3 &origin, const float3 &dir, float maxDistance) const
+    {
+        RayHit front = intersect(origin, dir, maxDistance);
+        // The backward ray only needs to beat the forward hit.
+        RayHit back = intersect(origin, make_float3(-dir.x, -dir.y, -dir.z), front.valid() ? front.t : maxDistance);
+        if (back.valid() && (!front.valid() || back.t < front.t))
+        {
+            back.t = -back.t;
+            return back;
+        }
+        return front;
+    }
+}
@@ -0,0 +1,115 @@
+#include "MeshNormals.h"
+#include "HostParallel.h"
+#include "MeshTopology.h"
+
+#include <cmath>
+
+namespace
+{
+    constexpr size_t kGrain = 16384;
+
+    inline float cornerAngle(const float3 &p, const float3 &a, const float3 &b)
+    {
+        float3 e0 = a - p;
+        float3 e1 = b - p;
+        return std::atan2(length(cross(e0, e1)), dot(e0, e1));
+    }
+
+    // Unit normal of one vertex from its incident faces (zero without non-degenerate faces).
+    float3 vertexNormal(const TriangleMesh &mesh, const SPIN::MeshTopology &topo, uint32_t v, SPIN::NormalWeighting weighting)
+    {
+        float3 sum = make_float3(0.0f, 0.0f, 0.0f);
+        for (const uint32_t *f = topo.facesBegin(v); f != topo.facesEnd(v); ++f)
+        {
+            const uint3 idx = mesh.index[*f];
+            const float3 &p0 = mesh.vertex[idx.x];
+            const float3 &p1 = mesh.vertex[idx.y];
+            const float3 &p2 = mesh.vertex[idx.z];
+            // |n| is twice the triangle area.
+            const float3 n = cross(p1 - p0, p2 - p0);
+            if (weighting == SPIN::NormalWeighting::AREA)
+            {
+                sum += n;
+                continue;
+            }
+            const float len = length(n);
+            if (len <= 0.0f)
+                continue;
+            float angle;
+            if (idx.x == v)
+                angle = cornerAngle(p0, p1, p2);
+            else if (idx.y == v)
+                angle = cornerAngle(p1, p2, p0);
+            else
+                angle = cornerAngle(p2, p0, p1);
+            sum += n * (angle / len);
+        }
+        const float len = length(sum);
+        return (len > 0.0f) ? sum / len : make_float3(0.0f, 0.0f, 0.0f);
+    }
+}
+
+namespace SPIN
+{
+    std::vector<float3> computeVertexNormals(const TriangleMesh &mesh, NormalWeighting weighting)
+    {
+        const size_t numVertices = mesh.vertex.size();
+        std::vector<float3> normals(numVertices, make_float3(0.0f, 0.0f, 0.0f));
+        if (numVertices == 0 || mesh.index.empty())
+            return normals;
+
+        const auto topo = meshTopology(mesh);
+
+        parallelFor(0, numVertices, kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+                normals[v] = vertexNormal(mesh, *topo, static_cast<uint32_t>(v), weighting);
+        });
+        return normals;
+    }
+
+    std::vector<float3> computeVertexNormals(const TriangleMesh &mesh, const std::vector<uint32_t> &vertices,
+                                             NormalWeighting weighting)
+    {
+        std::vector<float3> normals(vertices.size(), make_float3(0.0f, 0.0f, 0.0f));
+        if (vertices.empty() || mesh.index.empty())
+            return normals;
+
+        const auto topo = meshTopology(mesh);
+        parallelFor(0, vertices.size(), 1024, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+                normals[i] = vertexNormal(mesh, *topo, vertices[i], weighting);
+        });
+        return normals;
+    }
+
+    const std::vector<float3> &requireVertexNormals(TriangleMesh &mesh, NormalWeighting weighting)
+    {
+        if (mesh.normal.size() != mesh.vertex.size())
+            mesh.normal = computeVertexNormals(mesh, weighting);
+        return mesh.normal;
+    }
+
+    std::vector<float> computeVertexAreas(const TriangleMesh &mesh)
+    {
+        const size_t numVertices = mesh.vertex.size();
+        std::vector<float> areas(numVertices, 0.0f);
+        if (numVertices == 0 || mesh.index.empty())
+            return areas;
+
+        const auto topo = meshTopology(mesh);
+
+        parallelFor(0, numVertices, kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+            {
+                float sum = 0.0f;
+                for (const uint32_t *f = topo->facesBegin(v); f != topo->facesEnd(v); ++f)
+                {
+                    const uint3 idx = mesh.index[*f];
+                    sum += length(cross(mesh.vertex[idx.y] - mesh.vertex[idx.x], mesh.vertex[idx.z] - mesh.vertex[idx.x]));
+                }
+                areas[v] = sum / 6.0f;
+            }
+        });
+        return areas;
+    }
+}
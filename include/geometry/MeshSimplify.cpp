@@ -0,0 +1,782 @@
+#include "MeshSimplify.h"
+#include "HostParallel.h"
+#include "MeshTopology.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <queue>
+
+namespace
+{
+    // Symmetric 4x4 error quadric of plane equations (Garland & Heckbert), upper triangle row by row.
+    struct Quadric
+    {
+        double q[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        double weight = 0.0; // total surface plane weight, for a mean squared distance
+
+        // Constraint planes (boundaries) add to the error without diluting it through the weight.
+        void addPlane(const float3 &n, float d, double w, bool constraint = false)
+        {
+            const double a = n.x, b = n.y, c = n.z, dd = d;
+            if (!constraint)
+                weight += w;
+            q[0] += w * a * a;
+            q[1] += w * a * b;
+            q[2] += w * a * c;
+            q[3] += w * a * dd;
+            q[4] += w * b * b;
+            q[5] += w * b * c;
+            q[6] += w * b * dd;
+            q[7] += w * c * c;
+            q[8] += w * c * dd;
+            q[9] += w * dd * dd;
+        }
+
+        Quadric &operator+=(const Quadric &o)
+        {
+            for (int i = 0; i < 10; ++i)
+                q[i] += o.q[i];
+            weight += o.weight;
+            return *this;
+        }
+
+        // Weighted mean squared distance of p to the accumulated planes.
+        double error(const float3 &p) const
+        {
+            const double x = p.x, y = p.y, z = p.z;
+            const double e = q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x +
+                             q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y +
+                             q[7] * z * z + 2 * q[8] * z + q[9];
+            return weight > 0.0 ? std::max(0.0, e) / weight : 0.0;
+        }
+
+        // Minimizer of the quadric, or false when the 3x3 system is (nearly) singular.
+        bool optimum(float3 &x) const
+        {
+            const double a00 = q[0], a01 = q[1], a02 = q[2], a11 = q[4], a12 = q[5], a22 = q[7];
+            const double c00 = a11 * a22 - a12 * a12;
+            const double c01 = a02 * a12 - a01 * a22;
+            const double c02 = a01 * a12 - a02 * a11;
+            const double det = a00 * c00 + a01 * c01 + a02 * c02;
+            const double scale = (a00 + a11 + a22) / 3.0;
+            if (!(std::fabs(det) > 1e-6 * scale * scale * scale))
+                return false;
+            const double c11 = a00 * a22 - a02 * a02;
+            const double c12 = a01 * a02 - a00 * a12;
+            const double c22 = a00 * a11 - a01 * a01;
+            const double b0 = -q[3], b1 = -q[6], b2 = -q[8];
+            x = make_float3(static_cast<float>((c00 * b0 + c01 * b1 + c02 * b2) / det),
+                            static_cast<float>((c01 * b0 + c11 * b1 + c12 * b2) / det),
+                            static_cast<float>((c02 * b0 + c12 * b1 + c22 * b2) / det));
+            return true;
+        }
+    };
+
+    constexpr size_t kGrain = 16384;
+    constexpr uint32_t kMaxCellsPerAxis = 1024; // linear cell codes fit in 30 bits
+
+    // Mesh state shared by the decimation passes. Between passes every vertex is owned by at most one
+    // cell, so the cells write disjoint vertices and faces.
+    struct DecimationState
+    {
+        std::vector<float3> position;
+        std::vector<float3> normal;   // empty when the mesh has no per-vertex normals
+        std::vector<float2> texcoord; // empty when the mesh has no per-vertex texcoords
+        std::vector<Quadric> quadric;
+        std::vector<uint32_t> remap; // collapsed vertex -> vertex it merged into (itself while alive)
+        std::vector<uint3> face;
+        std::vector<uint8_t> faceAlive;
+        std::vector<std::atomic<uint8_t>> locked;
+    };
+
+    // Greedy edge collapse inside one cell of a pass. Only edges between unlocked vertices collapse;
+    // every face around an unlocked vertex belongs to the cell, so all checks are local.
+    class CellDecimator
+    {
+    public:
+        CellDecimator(DecimationState &state, const SPIN::DecimateOptions &options)
+            : m_state(state), m_options(options)
+        {
+        }
+
+        // Collapses until the cell has at most targetFaces faces or no collapse passes the checks.
+        // Returns the number of faces removed.
+        size_t run(const uint64_t *faceKeysBegin, const uint64_t *faceKeysEnd, size_t targetFaces)
+        {
+            const size_t numFaces = static_cast<size_t>(faceKeysEnd - faceKeysBegin);
+            m_globalFace.resize(numFaces);
+            m_vertexOf.clear();
+            for (size_t i = 0; i < numFaces; ++i)
+            {
+                m_globalFace[i] = static_cast<uint32_t>(faceKeysBegin[i] >> 32);
+                const uint3 f = m_state.face[m_globalFace[i]];
+                m_vertexOf.insert(m_vertexOf.end(), {f.x, f.y, f.z});
+            }
+            std::sort(m_vertexOf.begin(), m_vertexOf.end());
+            m_vertexOf.erase(std::unique(m_vertexOf.begin(), m_vertexOf.end()), m_vertexOf.end());
+
+            const size_t numVertices = m_vertexOf.size();
+            m_faces.resize(numFaces);
+            m_faceAlive.assign(numFaces, 1);
+            m_vertexFaces.assign(numVertices, {});
+            m_alive.assign(numVertices, 1);
+            m_stamp.assign(numVertices, 0);
+            m_free.resize(numVertices);
+            for (size_t v = 0; v < numVertices; ++v)
+                m_free[v] = m_state.locked[m_vertexOf[v]].load(std::memory_order_relaxed) == 0;
+            for (size_t i = 0; i < numFaces; ++i)
+            {
+                const uint3 f = m_state.face[m_globalFace[i]];
+                m_faces[i] = make_uint3(local(f.x), local(f.y), local(f.z));
+                m_vertexFaces[m_faces[i].x].push_back(static_cast<uint32_t>(i));
+                m_vertexFaces[m_faces[i].y].push_back(static_cast<uint32_t>(i));
+                m_vertexFaces[m_faces[i].z].push_back(static_cast<uint32_t>(i));
+            }
+
+            m_heap = {};
+            for (const uint3 &f : m_faces)
+            {
+                pushEdge(f.x, f.y);
+                pushEdge(f.y, f.z);
+                pushEdge(f.z, f.x);
+            }
+
+            size_t liveFaces = numFaces;
+            const double maxError2 = static_cast<double>(m_options.maxError) * m_options.maxError;
+            while (liveFaces > targetFaces && !m_heap.empty())
+            {
+                const Candidate c = m_heap.top();
+                m_heap.pop();
+                if (!m_alive[c.a] || !m_alive[c.b] || m_stamp[c.a] != c.stampA || m_stamp[c.b] != c.stampB)
+                    continue;
+                // Costs only grow from here on (stale entries are re-pushed after a collapse).
+                if (c.cost > maxError2)
+                    break;
+                if (!collapsible(c.a, c.b, c.position))
+                    continue;
+                liveFaces -= collapse(c.a, c.b, c.position);
+            }
+
+            writeBack();
+            return numFaces - liveFaces;
+        }
+
+    private:
+        struct Candidate
+        {
+            double cost;
+            float3 position;
+            uint32_t a, b; // b collapses into a
+            uint32_t stampA, stampB;
+
+            bool operator>(const Candidate &o) const { return cost > o.cost; }
+        };
+
+        uint32_t local(uint32_t globalVertex) const
+        {
+            return static_cast<uint32_t>(std::lower_bound(m_vertexOf.begin(), m_vertexOf.end(), globalVertex) - m_vertexOf.begin());
+        }
+        const float3 &position(uint32_t v) const { return m_state.position[m_vertexOf[v]]; }
+        Quadric &quadric(uint32_t v) { return m_state.quadric[m_vertexOf[v]]; }
+
+        void pushEdge(uint32_t a, uint32_t b)
+        {
+            if (!m_free[a] || !m_free[b])
+                return;
+            Quadric q = quadric(a);
+            q += quadric(b);
+
+            // Quadric minimizer when it is well conditioned and near the edge, else the best of the
+            // endpoints and the midpoint.
+            const float3 pa = position(a), pb = position(b), mid = 0.5f * (pa + pb);
+            float3 best = mid;
+            double cost = q.error(mid);
+            float3 x;
+            if (q.optimum(x) && length(x - mid) <= length(pb - pa))
+            {
+                best = x;
+                cost = q.error(x);
+            }
+            else
+            {
+                for (const float3 &p : {pa, pb})
+                {
+                    const double e = q.error(p);
+                    if (e < cost)
+                    {
+                        best = p;
+                        cost = e;
+                    }
+                }
+            }
+            m_heap.push({cost, best, a, b, m_stamp[a], m_stamp[b]});
+        }
+
+        // Counts the faces around v using each neighbor; a neighbor seen once lies across a boundary edge.
+        bool onBoundary(uint32_t v)
+        {
+            m_scratch.clear();
+            for (uint32_t f : m_vertexFaces[v])
+            {
+                const uint3 t = m_faces[f];
+                if (t.x != v) m_scratch.push_back(t.x);
+                if (t.y != v) m_scratch.push_back(t.y);
+                if (t.z != v) m_scratch.push_back(t.z);
+            }
+            std::sort(m_scratch.begin(), m_scratch.end());
+            for (size_t i = 0; i < m_scratch.size();)
+            {
+                size_t j = i;
+                while (j < m_scratch.size() && m_scratch[j] == m_scratch[i])
+                    ++j;
+                if (j - i == 1)
+                    return true;
+                i = j;
+            }
+            return false;
+        }
+
+        void neighbors(uint32_t v, std::vector<uint32_t> &out) const
+        {
+            out.clear();
+            for (uint32_t f : m_vertexFaces[v])
+            {
+                const uint3 t = m_faces[f];
+                for (uint32_t u : {t.x, t.y, t.z})
+                    if (u != v)
+                        out.push_back(u);
+            }
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        }
+
+        static bool hasVertex(const uint3 &t, uint32_t v) { return t.x == v || t.y == v || t.z == v; }
+
+        // Link condition (the collapse keeps a manifold neighborhood manifold) and no flipped faces.
+        bool collapsible(uint32_t a, uint32_t b, const float3 &x)
+        {
+            size_t shared = 0;
+            for (uint32_t f : m_vertexFaces[a])
+                shared += hasVertex(m_faces[f], b);
+            if (shared == 0 || shared > 2)
+                return false;
+
+            neighbors(a, m_ringA);
+            neighbors(b, m_ringB);
+            size_t common = 0;
+            for (uint32_t u : m_ringA)
+                common += (u != b) && std::binary_search(m_ringB.begin(), m_ringB.end(), u);
+            if (common != shared)
+                return false;
+            // An interior edge between two boundary vertices would pinch the surface.
+            if (shared == 2 && onBoundary(a) && onBoundary(b))
+                return false;
+
+            for (uint32_t v : {a, b})
+            {
+                const uint32_t other = (v == a) ? b : a;
+                for (uint32_t f : m_vertexFaces[v])
+                {
+                    const uint3 t = m_faces[f];
+                    if (hasVertex(t, other))
+                        continue;
+                    const float3 p0 = position(t.x), p1 = position(t.y), p2 = position(t.z);
+                    const float3 q0 = (t.x == v) ? x : p0, q1 = (t.y == v) ? x : p1, q2 = (t.z == v) ? x : p2;
+                    const float3 before = cross(p1 - p0, p2 - p0);
+                    const float3 after = cross(q1 - q0, q2 - q0);
+                    if (!(dot(before, after) > 0.0f))
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        // Merges b into a at x and returns the number of faces removed.
+        size_t collapse(uint32_t a, uint32_t b, const float3 &x)
+        {
+            const uint32_t ga = m_vertexOf[a], gb = m_vertexOf[b];
+
+            // Attributes follow the projection of x onto the collapsed edge.
+            const float3 pa = position(a), pb = position(b);
+            const float len2 = dot(pb - pa, pb - pa);
+            const float t = len2 > 0.0f ? std::min(1.0f, std::max(0.0f, dot(x - pa, pb - pa) / len2)) : 0.5f;
+            if (!m_state.normal.empty())
+            {
+                const float3 n = lerp(m_state.normal[ga], m_state.normal[gb], t);
+                const float len = length(n);
+                m_state.normal[ga] = len > 0.0f ? n / len : m_state.normal[ga];
+            }
+            if (!m_state.texcoord.empty())
+                m_state.texcoord[ga] = lerp(m_state.texcoord[ga], m_state.texcoord[gb], t);
+            m_state.position[ga] = x;
+            quadric(a) += quadric(b);
+            m_state.remap[gb] = ga;
+
+            size_t removed = 0;
+            for (uint32_t f : m_vertexFaces[b])
+            {
+                uint3 &tri = m_faces[f];
+                if (hasVertex(tri, a))
+                {
+                    m_faceAlive[f] = 0;
+                    ++removed;
+                    for (uint32_t u : {tri.x, tri.y, tri.z})
+                        if (u != b)
+                        {
+                            auto &list = m_vertexFaces[u];
+                            list.erase(std::find(list.begin(), list.end(), f));
+                        }
+                    continue;
+                }
+                if (tri.x == b) tri.x = a;
+                if (tri.y == b) tri.y = a;
+                if (tri.z == b) tri.z = a;
+                m_vertexFaces[a].push_back(f);
+            }
+            m_vertexFaces[b].clear();
+            m_alive[b] = 0;
+            ++m_stamp[a];
+
+            neighbors(a, m_ringA);
+            for (uint32_t u : m_ringA)
+                pushEdge(a, u);
+            return removed;
+        }
+
+        void writeBack()
+        {
+            for (size_t i = 0; i < m_faces.size(); ++i)
+            {
+                const uint32_t g = m_globalFace[i];
+                m_state.faceAlive[g] = m_faceAlive[i];
+                if (m_faceAlive[i])
+                    m_state.face[g] = make_uint3(m_vertexOf[m_faces[i].x], m_vertexOf[m_faces[i].y], m_vertexOf[m_faces[i].z]);
+            }
+        }
+
+        DecimationState &m_state;
+        const SPIN::DecimateOptions &m_options;
+
+        std::vector<uint32_t> m_globalFace;
+        std::vector<uint32_t> m_vertexOf; // local -> global vertex, sorted
+        std::vector<uint3> m_faces;       // local vertex ids
+        std::vector<uint8_t> m_faceAlive;
+        std::vector<std::vector<uint32_t>> m_vertexFaces;
+        std::vector<uint8_t> m_alive, m_free;
+        std::vector<uint32_t> m_stamp;
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> m_heap;
+        std::vector<uint32_t> m_ringA, m_ringB, m_scratch;
+    };
+}
+
+namespace SPIN
+{
+    SimplifiedMesh clusterSimplify(const TriangleMesh &mesh, size_t targetTriangles)
+    {
+        SimplifiedMesh out;
+        const size_t numVertices = mesh.vertex.size();
+        if (numVertices == 0 || mesh.index.empty() || targetTriangles >= mesh.index.size())
+        {
+            out.mesh = mesh;
+            out.vertexMap.resize(numVertices);
+            for (size_t v = 0; v < numVertices; ++v)
+                out.vertexMap[v] = static_cast<uint32_t>(v);
+            return out;
+        }
+
+        // Bounds and surface area.
+        struct Partial
+        {
+            float3 lo = {INFINITY, INFINITY, INFINITY};
+            float3 hi = {-INFINITY, -INFINITY, -INFINITY};
+            double area = 0.0;
+        };
+        std::vector<Partial> partials(hostWorkerCount());
+        parallelFor(0, numVertices, kGrain, [&](size_t b, size_t e, unsigned worker) {
+            for (size_t v = b; v < e; ++v)
+            {
+                partials[worker].lo = fminf(partials[worker].lo, mesh.vertex[v]);
+                partials[worker].hi = fmaxf(partials[worker].hi, mesh.vertex[v]);
+            }
+        });
+        parallelFor(0, mesh.index.size(), kGrain, [&](size_t b, size_t e, unsigned worker) {
+            for (size_t f = b; f < e; ++f)
+            {
+                const uint3 idx = mesh.index[f];
+                partials[worker].area += 0.5 * length(cross(mesh.vertex[idx.y] - mesh.vertex[idx.x], mesh.vertex[idx.z] - mesh.vertex[idx.x]));
+            }
+        });
+        Partial total;
+        for (const Partial &p : partials)
+        {
+            total.lo = fminf(total.lo, p.lo);
+            total.hi = fmaxf(total.hi, p.hi);
+            total.area += p.area;
+        }
+
+        // A surface crossing k cells gives about k vertices and 2k triangles.
+        const float3 extent = total.hi - total.lo;
+        const float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+        float cell = static_cast<float>(std::sqrt(2.0 * total.area / static_cast<double>(std::max<size_t>(1, targetTriangles))));
+        cell = std::max(cell, maxExtent / static_cast<float>(kMaxCellsPerAxis));
+        if (!(cell > 0.0f))
+            cell = 1.0f;
+        const uint32_t dimX = std::min(kMaxCellsPerAxis, static_cast<uint32_t>(extent.x / cell) + 1);
+        const uint32_t dimY = std::min(kMaxCellsPerAxis, static_cast<uint32_t>(extent.y / cell) + 1);
+        const uint32_t dimZ = std::min(kMaxCellsPerAxis, static_cast<uint32_t>(extent.z / cell) + 1);
+
+        // Vertex index in the high half, cell code in the low 30 bits; the stable sort groups cells.
+        std::vector<uint64_t> keys(numVertices);
+        parallelFor(0, numVertices, kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+            {
+                const float3 rel = (mesh.vertex[v] - total.lo) / cell;
+                const uint32_t ix = std::min(dimX - 1, static_cast<uint32_t>(std::max(0.0f, rel.x)));
+                const uint32_t iy = std::min(dimY - 1, static_cast<uint32_t>(std::max(0.0f, rel.y)));
+                const uint32_t iz = std::min(dimZ - 1, static_cast<uint32_t>(std::max(0.0f, rel.z)));
+                keys[v] = (uint64_t(v) << 32) | (ix + dimX * (iy + dimY * iz));
+            }
+        });
+        parallelRadixSort(keys, 30);
+
+        auto cellOf = [&](size_t k) { return static_cast<uint32_t>(keys[k]); };
+        std::vector<uint32_t> runStart = parallelSelect(numVertices, [&](size_t k) { return k == 0 || cellOf(k) != cellOf(k - 1); });
+        const size_t numClusters = runStart.size();
+        runStart.push_back(static_cast<uint32_t>(numVertices));
+
+        out.vertexMap.resize(numVertices);
+        parallelFor(0, numClusters, 4096, [&](size_t b, size_t e, unsigned) {
+            for (size_t c = b; c < e; ++c)
+                for (uint32_t k = runStart[c]; k < runStart[c + 1]; ++k)
+                    out.vertexMap[keys[k] >> 32] = static_cast<uint32_t>(c);
+        });
+
+        // Representatives: each cluster gathers the planes of its incident faces (a face counted once per
+        // cluster, by its first corner inside it) and sits at the quadric minimizer inside its cell.
+        const auto topo = meshTopology(mesh);
+        out.mesh.vertex.resize(numClusters);
+        parallelFor(0, numClusters, 1024, [&](size_t b, size_t e, unsigned) {
+            for (size_t c = b; c < e; ++c)
+            {
+                Quadric quadric;
+                float3 mean = make_float3(0.0f, 0.0f, 0.0f);
+                for (uint32_t k = runStart[c]; k < runStart[c + 1]; ++k)
+                {
+                    const uint32_t v = static_cast<uint32_t>(keys[k] >> 32);
+                    mean += mesh.vertex[v];
+                    for (const uint32_t *f = topo->facesBegin(v); f != topo->facesEnd(v); ++f)
+                    {
+                        const uint3 idx = mesh.index[*f];
+                        const uint32_t first = (out.vertexMap[idx.x] == c) ? idx.x : (out.vertexMap[idx.y] == c) ? idx.y : idx.z;
+                        if (first != v)
+                            continue;
+                        const float3 &p0 = mesh.vertex[idx.x];
+                        float3 n = cross(mesh.vertex[idx.y] - p0, mesh.vertex[idx.z] - p0);
+                        const float len = length(n);
+                        if (len <= 0.0f)
+                            continue;
+                        n /= len;
+                        quadric.addPlane(n, -dot(n, p0), 0.5 * len);
+                    }
+                }
+                mean /= static_cast<float>(runStart[c + 1] - runStart[c]);
+
+                // Fall back to the mean for flat or degenerate clusters, or a minimizer far outside the cell.
+                float3 x;
+                if (quadric.optimum(x) && length(x - mean) <= cell)
+                    out.mesh.vertex[c] = x;
+                else
+                    out.mesh.vertex[c] = mean;
+            }
+        });
+
+        // Faces spanning three clusters survive; duplicates are merged when cluster ids fit 21 bits.
+        const std::vector<uint32_t> kept = parallelSelect(mesh.index.size(), [&](size_t f) {
+            const uint3 idx = mesh.index[f];
+            const uint32_t a = out.vertexMap[idx.x], b = out.vertexMap[idx.y], c = out.vertexMap[idx.z];
+            return a != b && b != c && a != c;
+        });
+        auto mappedFace = [&](uint32_t f) {
+            const uint3 idx = mesh.index[f];
+            uint3 t = make_uint3(out.vertexMap[idx.x], out.vertexMap[idx.y], out.vertexMap[idx.z]);
+            // Rotate the smallest id first: same orientation, canonical form.
+            if (t.y < t.x && t.y < t.z)
+                t = make_uint3(t.y, t.z, t.x);
+            else if (t.z < t.x && t.z < t.y)
+                t = make_uint3(t.z, t.x, t.y);
+            return t;
+        };
+
+        if (numClusters < (size_t(1) << 21))
+        {
+            std::vector<uint64_t> faceKeys(kept.size());
+            parallelFor(0, kept.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+                for (size_t i = b; i < e; ++i)
+                {
+                    const uint3 t = mappedFace(kept[i]);
+                    faceKeys[i] = (uint64_t(t.x) << 42) | (uint64_t(t.y) << 21) | uint64_t(t.z);
+                }
+            });
+            parallelRadixSort(faceKeys, 63);
+            faceKeys.erase(std::unique(faceKeys.begin(), faceKeys.end()), faceKeys.end());
+            out.mesh.index.resize(faceKeys.size());
+            constexpr uint64_t kMask = (uint64_t(1) << 21) - 1;
+            parallelFor(0, faceKeys.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+                for (size_t i = b; i < e; ++i)
+                    out.mesh.index[i] = make_uint3(static_cast<uint32_t>(faceKeys[i] >> 42),
+                                                   static_cast<uint32_t>((faceKeys[i] >> 21) & kMask),
+                                                   static_cast<uint32_t>(faceKeys[i] & kMask));
+            });
+        }
+        else
+        {
+            out.mesh.index.resize(kept.size());
+            parallelFor(0, kept.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+                for (size_t i = b; i < e; ++i)
+                    out.mesh.index[i] = mappedFace(kept[i]);
+            });
+        }
+
+        out.mesh.name = mesh.name;
+        out.mesh.materialID = mesh.materialID;
+        out.mesh.materialTextureID = mesh.materialTextureID;
+        return out;
+    }
+
+    SimplifiedMesh decimateMesh(const TriangleMesh &mesh, const DecimateOptions &options)
+    {
+        const size_t numVertices = mesh.vertex.size();
+        DecimationState state;
+        state.position = mesh.vertex;
+        if (mesh.normal.size() == numVertices)
+            state.normal = mesh.normal;
+        if (mesh.texcoord.size() == numVertices)
+            state.texcoord = mesh.texcoord;
+        state.face = mesh.index;
+        state.faceAlive.resize(mesh.index.size());
+        state.remap.resize(numVertices);
+        state.quadric.resize(numVertices);
+        state.locked = std::vector<std::atomic<uint8_t>>(numVertices);
+
+        parallelFor(0, numVertices, kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+                state.remap[v] = static_cast<uint32_t>(v);
+        });
+        parallelFor(0, mesh.index.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t f = b; f < e; ++f)
+            {
+                const uint3 t = mesh.index[f];
+                state.faceAlive[f] = t.x != t.y && t.y != t.z && t.x != t.z;
+            }
+        });
+
+        // Vertex quadrics: area-weighted planes of the incident faces, plus a plane through every
+        // boundary edge perpendicular to its face.
+        const auto topo = meshTopology(mesh);
+        parallelFor(0, numVertices, 4096, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+            {
+                Quadric &q = state.quadric[v];
+                for (const uint32_t *f = topo->facesBegin(static_cast<uint32_t>(v)); f != topo->facesEnd(static_cast<uint32_t>(v)); ++f)
+                {
+                    if (!state.faceAlive[*f])
+                        continue;
+                    const uint3 idx = mesh.index[*f];
+                    const float3 &p0 = mesh.vertex[idx.x];
+                    float3 n = cross(mesh.vertex[idx.y] - p0, mesh.vertex[idx.z] - p0);
+                    const float len = length(n);
+                    if (len <= 0.0f)
+                        continue;
+                    n /= len;
+                    q.addPlane(n, -dot(n, p0), 0.5 * len);
+
+                    if (options.boundaryWeight <= 0.0f)
+                        continue;
+                    // Edges from v in this face; an edge is on the boundary when no other face of v has it.
+                    const uint32_t others[2] = {idx.x == v ? idx.y : idx.x, idx.z == v ? idx.y : idx.z};
+                    for (uint32_t u : others)
+                    {
+                        int count = 0;
+                        for (const uint32_t *g = topo->facesBegin(static_cast<uint32_t>(v)); g != topo->facesEnd(static_cast<uint32_t>(v)); ++g)
+                        {
+                            const uint3 t = mesh.index[*g];
+                            count += state.faceAlive[*g] && (t.x == u || t.y == u || t.z == u);
+                        }
+                        if (count != 1)
+                            continue;
+                        const float3 edge = mesh.vertex[u] - mesh.vertex[v];
+                        float3 m = cross(edge, n);
+                        const float mLen = length(m);
+                        if (mLen <= 0.0f)
+                            continue;
+                        m /= mLen;
+                        q.addPlane(m, -dot(m, mesh.vertex[v]), options.boundaryWeight * dot(edge, edge), true);
+                    }
+                }
+            }
+        });
+
+        auto countAlive = [&]() {
+            std::vector<size_t> partial(hostWorkerCount(), 0);
+            parallelFor(0, state.face.size(), kGrain, [&](size_t b, size_t e, unsigned worker) {
+                for (size_t f = b; f < e; ++f)
+                    partial[worker] += state.faceAlive[f];
+            });
+            size_t n = 0;
+            for (size_t p : partial)
+                n += p;
+            return n;
+        };
+
+        // Bounds and surface area fix the cell size: cells hold a few thousand faces, with enough cells
+        // to keep every worker busy on large meshes.
+        float3 lo = make_float3(INFINITY, INFINITY, INFINITY), hi = make_float3(-INFINITY, -INFINITY, -INFINITY);
+        for (const float3 &p : mesh.vertex)
+        {
+            lo = fminf(lo, p);
+            hi = fmaxf(hi, p);
+        }
+        double area = 0.0;
+        for (const uint3 &t : mesh.index)
+            area += 0.5 * length(cross(mesh.vertex[t.y] - mesh.vertex[t.x], mesh.vertex[t.z] - mesh.vertex[t.x]));
+
+        size_t liveFaces = countAlive();
+        int idlePasses = 0;
+        for (int pass = 0; pass < options.maxPasses && idlePasses < 2; ++pass)
+        {
+            if (liveFaces == 0 || (options.targetTriangles > 0 && liveFaces <= options.targetTriangles))
+                break;
+
+            const size_t numCells = std::max<size_t>(1, std::min(std::max<size_t>(liveFaces / 20000, size_t(hostWorkerCount()) * 4), liveFaces / 2000));
+            const float3 extent = hi - lo;
+            const float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+            float cell = static_cast<float>(std::sqrt(area / static_cast<double>(numCells)));
+            cell = std::max(cell, maxExtent / static_cast<float>(kMaxCellsPerAxis - 1));
+            if (!(cell > 0.0f))
+                cell = 1.0f;
+            // Shift the grid every pass so vertices locked on cell borders are interior next time.
+            const float shift = static_cast<float>(pass) * 0.618034f;
+            const float3 origin = lo - cell * make_float3(shift - std::floor(shift), (shift * 1.5f) - std::floor(shift * 1.5f), (shift * 2.5f) - std::floor(shift * 2.5f));
+            // A single cell needs no grid: nothing is locked and the pass is the serial algorithm.
+            const bool single = numCells == 1;
+            const uint32_t dimX = single ? 1 : std::min(kMaxCellsPerAxis, static_cast<uint32_t>((hi.x - origin.x) / cell) + 1);
+            const uint32_t dimY = single ? 1 : std::min(kMaxCellsPerAxis, static_cast<uint32_t>((hi.y - origin.y) / cell) + 1);
+            const uint32_t dimZ = single ? 1 : std::min(kMaxCellsPerAxis, static_cast<uint32_t>((hi.z - origin.z) / cell) + 1);
+            auto cellOf = [&](uint32_t v) {
+                const float3 rel = (state.position[v] - origin) / cell;
+                const uint32_t ix = std::min(dimX - 1, static_cast<uint32_t>(std::max(0.0f, rel.x)));
+                const uint32_t iy = std::min(dimY - 1, static_cast<uint32_t>(std::max(0.0f, rel.y)));
+                const uint32_t iz = std::min(dimZ - 1, static_cast<uint32_t>(std::max(0.0f, rel.z)));
+                return ix + dimX * (iy + dimY * iz);
+            };
+
+            // A face belongs to a cell when all its corners do; the corners of the other faces are locked.
+            parallelFor(0, numVertices, kGrain, [&](size_t b, size_t e, unsigned) {
+                for (size_t v = b; v < e; ++v)
+                    state.locked[v].store(0, std::memory_order_relaxed);
+            });
+            const std::vector<uint32_t> owned = parallelSelect(state.face.size(), [&](size_t f) {
+                if (!state.faceAlive[f])
+                    return false;
+                const uint3 t = state.face[f];
+                const uint32_t c = cellOf(t.x);
+                if (cellOf(t.y) == c && cellOf(t.z) == c)
+                    return true;
+                state.locked[t.x].store(1, std::memory_order_relaxed);
+                state.locked[t.y].store(1, std::memory_order_relaxed);
+                state.locked[t.z].store(1, std::memory_order_relaxed);
+                return false;
+            });
+            std::vector<uint64_t> keys(owned.size());
+            parallelFor(0, owned.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+                for (size_t i = b; i < e; ++i)
+                    keys[i] = (uint64_t(owned[i]) << 32) | cellOf(state.face[owned[i]].x);
+            });
+            parallelRadixSort(keys, 30);
+            std::vector<uint32_t> runStart = parallelSelect(keys.size(), [&](size_t k) {
+                return k == 0 || static_cast<uint32_t>(keys[k]) != static_cast<uint32_t>(keys[k - 1]);
+            });
+            const size_t numRuns = runStart.size();
+            runStart.push_back(static_cast<uint32_t>(keys.size()));
+
+            // Faces spanning cells stay this pass; the owned ones shrink by a common ratio.
+            const size_t spanning = liveFaces - owned.size();
+            double ratio = 0.0;
+            if (options.targetTriangles > 0 && !owned.empty())
+                ratio = std::min(1.0, std::max(0.0, (static_cast<double>(options.targetTriangles) - static_cast<double>(spanning)) /
+                                                        static_cast<double>(owned.size())));
+
+            std::vector<size_t> removed(hostWorkerCount(), 0);
+            parallelFor(0, numRuns, 1, [&](size_t b, size_t e, unsigned worker) {
+                CellDecimator decimator(state, options);
+                for (size_t r = b; r < e; ++r)
+                {
+                    const size_t cellFaces = runStart[r + 1] - runStart[r];
+                    const size_t target = static_cast<size_t>(std::ceil(ratio * static_cast<double>(cellFaces)));
+                    removed[worker] += decimator.run(keys.data() + runStart[r], keys.data() + runStart[r + 1], target);
+                }
+            });
+            size_t removedTotal = 0;
+            for (size_t n : removed)
+                removedTotal += n;
+            liveFaces -= removedTotal;
+            idlePasses = removedTotal == 0 ? idlePasses + 1 : 0;
+        }
+
+        // Resolve collapse chains and compact the surviving vertices and faces.
+        SimplifiedMesh out;
+        std::vector<uint32_t> root(numVertices);
+        parallelFor(0, numVertices, kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+            {
+                uint32_t r = static_cast<uint32_t>(v);
+                while (state.remap[r] != r)
+                    r = state.remap[r];
+                root[v] = r;
+            }
+        });
+        const std::vector<uint32_t> survivors = parallelSelect(numVertices, [&](size_t v) { return root[v] == v; });
+        std::vector<uint32_t> outIndex(numVertices, 0);
+        parallelFor(0, survivors.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+                outIndex[survivors[i]] = static_cast<uint32_t>(i);
+        });
+        out.vertexMap.resize(numVertices);
+        parallelFor(0, numVertices, kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+                out.vertexMap[v] = outIndex[root[v]];
+        });
+
+        out.mesh.vertex.resize(survivors.size());
+        if (!state.normal.empty())
+            out.mesh.normal.resize(survivors.size());
+        if (!state.texcoord.empty())
+            out.mesh.texcoord.resize(survivors.size());
+        parallelFor(0, survivors.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+            {
+                out.mesh.vertex[i] = state.position[survivors[i]];
+                if (!state.normal.empty())
+                    out.mesh.normal[i] = state.normal[survivors[i]];
+                if (!state.texcoord.empty())
+                    out.mesh.texcoord[i] = state.texcoord[survivors[i]];
+            }
+        });
+
+        const std::vector<uint32_t> kept = parallelSelect(state.face.size(), [&](size_t f) { return state.faceAlive[f] != 0; });
+        out.mesh.index.resize(kept.size());
+        parallelFor(0, kept.size(), kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+            {
+                const uint3 t = state.face[kept[i]];
+                out.mesh.index[i] = make_uint3(outIndex[root[t.x]], outIndex[root[t.y]], outIndex[root[t.z]]);
+            }
+        });
+
+        out.mesh.name = mesh.name;
+        out.mesh.materialID = mesh.materialID;
+        out.mesh.materialTextureID = mesh.materialTextureID;
+        return out;
+    }
+}
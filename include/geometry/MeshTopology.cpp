@@ -0,0 +1,175 @@
+#include "MeshTopology.h"
+#include "HostParallel.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+    constexpr size_t kGrain = 16384;
+
+    unsigned bitsFor(size_t count)
+    {
+        unsigned bits = 1;
+        while (bits < 32 && (size_t(1) << bits) < count)
+            ++bits;
+        return bits;
+    }
+
+    // Exclusive scan of counts into offsets[0..n]; counts are reused as fill cursors.
+    void countsToOffsets(std::vector<std::atomic<uint32_t>> &counts, std::vector<uint32_t> &offsets)
+    {
+        const size_t n = counts.size();
+        offsets.resize(n + 1);
+        offsets[0] = 0;
+        for (size_t v = 0; v < n; ++v)
+        {
+            offsets[v + 1] = offsets[v] + counts[v].load(std::memory_order_relaxed);
+            counts[v].store(offsets[v], std::memory_order_relaxed);
+        }
+    }
+
+    void sortLists(const std::vector<uint32_t> &offsets, std::vector<uint32_t> &items)
+    {
+        SPIN::parallelFor(0, offsets.size() - 1, kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+                std::sort(items.begin() + offsets[v], items.begin() + offsets[v + 1]);
+        });
+    }
+}
+
+namespace SPIN
+{
+    std::shared_ptr<const MeshTopology> buildMeshTopology(const TriangleMesh &mesh)
+    {
+        auto topo = std::make_shared<MeshTopology>();
+        const size_t numVertices = mesh.vertex.size();
+        const size_t numFaces = mesh.index.size();
+        topo->numVertices = numVertices;
+        topo->numFaces = numFaces;
+
+        std::vector<std::atomic<uint32_t>> counts(numVertices);
+        parallelFor(0, numVertices, kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+                counts[v].store(0, std::memory_order_relaxed);
+        });
+
+        // Vertex -> face.
+        parallelFor(0, numFaces, kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t f = b; f < e; ++f)
+            {
+                const uint3 idx = mesh.index[f];
+                counts[idx.x].fetch_add(1, std::memory_order_relaxed);
+                counts[idx.y].fetch_add(1, std::memory_order_relaxed);
+                counts[idx.z].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        countsToOffsets(counts, topo->vertexFaceOffsets);
+        topo->vertexFaces.resize(topo->vertexFaceOffsets[numVertices]);
+        parallelFor(0, numFaces, kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t f = b; f < e; ++f)
+            {
+                const uint3 idx = mesh.index[f];
+                const uint32_t face = static_cast<uint32_t>(f);
+                topo->vertexFaces[counts[idx.x].fetch_add(1, std::memory_order_relaxed)] = face;
+                topo->vertexFaces[counts[idx.y].fetch_add(1, std::memory_order_relaxed)] = face;
+                topo->vertexFaces[counts[idx.z].fetch_add(1, std::memory_order_relaxed)] = face;
+            }
+        });
+        sortLists(topo->vertexFaceOffsets, topo->vertexFaces);
+
+        // Unique edges: radix sort of packed (min, max) keys, one per face corner.
+        const unsigned vertexBits = bitsFor(numVertices);
+        std::vector<uint64_t> keys(numFaces * 3);
+        parallelFor(0, numFaces, kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t f = b; f < e; ++f)
+            {
+                const uint3 idx = mesh.index[f];
+                const uint32_t corners[3] = {idx.x, idx.y, idx.z};
+                for (int k = 0; k < 3; ++k)
+                {
+                    const uint64_t a = corners[k];
+                    const uint64_t c = corners[(k + 1) % 3];
+                    keys[f * 3 + k] = (std::min(a, c) << vertexBits) | std::max(a, c);
+                }
+            }
+        });
+        parallelRadixSort(keys, 2 * vertexBits);
+
+        // Compact runs of equal keys into unique edges (count per block, scan, then fill).
+        const uint64_t lowMask = (uint64_t(1) << vertexBits) - 1;
+        const size_t numKeys = keys.size();
+        auto isEdgeStart = [&](size_t i) {
+            if (i > 0 && keys[i] == keys[i - 1])
+                return false;
+            return (keys[i] >> vertexBits) != (keys[i] & lowMask); // skip degenerate corners
+        };
+        const size_t blockSize = std::max<size_t>(kGrain, (numKeys + hostWorkerCount() - 1) / hostWorkerCount());
+        const size_t numBlocks = (numKeys + blockSize - 1) / blockSize;
+        std::vector<size_t> blockStart(numBlocks + 1, 0);
+        parallelFor(0, numKeys, blockSize, [&](size_t b, size_t e, unsigned) {
+            size_t count = 0;
+            for (size_t i = b; i < e; ++i)
+                count += isEdgeStart(i) ? 1 : 0;
+            blockStart[b / blockSize + 1] = count;
+        });
+        for (size_t blk = 0; blk < numBlocks; ++blk)
+            blockStart[blk + 1] += blockStart[blk];
+
+        topo->edges.resize(blockStart[numBlocks]);
+        topo->edgeFaceCount.resize(blockStart[numBlocks]);
+        parallelFor(0, numKeys, blockSize, [&](size_t b, size_t e, unsigned) {
+            size_t out = blockStart[b / blockSize];
+            for (size_t i = b; i < e; ++i)
+            {
+                if (!isEdgeStart(i))
+                    continue;
+                size_t j = i + 1;
+                while (j < numKeys && keys[j] == keys[i])
+                    ++j;
+                topo->edges[out] = make_uint2(static_cast<uint32_t>(keys[i] >> vertexBits),
+                                              static_cast<uint32_t>(keys[i] & lowMask));
+                topo->edgeFaceCount[out] = static_cast<uint32_t>(j - i);
+                ++out;
+            }
+        });
+
+        // Vertex -> vertex from the unique edges.
+        parallelFor(0, numVertices, kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+                counts[v].store(0, std::memory_order_relaxed);
+        });
+        const size_t numEdges = topo->edges.size();
+        parallelFor(0, numEdges, kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+            {
+                counts[topo->edges[i].x].fetch_add(1, std::memory_order_relaxed);
+                counts[topo->edges[i].y].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        countsToOffsets(counts, topo->vertexVertexOffsets);
+        topo->vertexVertices.resize(topo->vertexVertexOffsets[numVertices]);
+        parallelFor(0, numEdges, kGrain, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+            {
+                const uint2 ed = topo->edges[i];
+                topo->vertexVertices[counts[ed.x].fetch_add(1, std::memory_order_relaxed)] = ed.y;
+                topo->vertexVertices[counts[ed.y].fetch_add(1, std::memory_order_relaxed)] = ed.x;
+            }
+        });
+        sortLists(topo->vertexVertexOffsets, topo->vertexVertices);
+
+        return topo;
+    }
+
+    std::shared_ptr<const MeshTopology> meshTopology(const TriangleMesh &mesh)
+    {
+        std::shared_ptr<const MeshTopology> topo = std::atomic_load(&mesh.topologyCache);
+        if (!topo || !topo->matches(mesh))
+        {
+            topo = buildMeshTopology(mesh);
+            std::atomic_store(&mesh.topologyCache, topo);
+        }
+        return topo;
+    }
+}
@@ -0,0 +1,79 @@
+#include "MeshTransform.h"
+#include "HostParallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr size_t kLanes = 64;
+
+    // out = L * in (+ t) for one block of at most kLanes points, through x/y/z lanes.
+    void transformBlock(const float *L, const float *t, bool normalizeOut, const float3 *in, float3 *out, size_t count)
+    {
+        float x[kLanes], y[kLanes], z[kLanes];
+        float ox[kLanes], oy[kLanes], oz[kLanes];
+        for (size_t i = 0; i < count; ++i)
+        {
+            x[i] = in[i].x;
+            y[i] = in[i].y;
+            z[i] = in[i].z;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            ox[i] = L[0] * x[i] + L[1] * y[i] + L[2] * z[i] + t[0];
+            oy[i] = L[3] * x[i] + L[4] * y[i] + L[5] * z[i] + t[1];
+            oz[i] = L[6] * x[i] + L[7] * y[i] + L[8] * z[i] + t[2];
+        }
+        if (normalizeOut)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                const float len2 = ox[i] * ox[i] + oy[i] * oy[i] + oz[i] * oz[i];
+                const float s = len2 > 0.0f ? 1.0f / std::sqrt(len2) : 0.0f;
+                ox[i] *= s;
+                oy[i] *= s;
+                oz[i] *= s;
+            }
+        }
+        for (size_t i = 0; i < count; ++i)
+            out[i] = make_float3(ox[i], oy[i], oz[i]);
+    }
+
+    void transformArray(const float *L, const float *t, bool normalizeOut, const float3 *in, float3 *out, size_t count)
+    {
+        SPIN::parallelFor(0, count, 16384, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; i += kLanes)
+                transformBlock(L, t, normalizeOut, in + i, out + i, std::min(kLanes, e - i));
+        });
+    }
+}
+
+namespace SPIN
+{
+    void transformPoints(const Affine &a, const float3 *in, float3 *out, size_t count)
+    {
+        const float *m = a.m;
+        const float L[9] = {m[0], m[1], m[2], m[4], m[5], m[6], m[8], m[9], m[10]};
+        const float t[3] = {m[3], m[7], m[11]};
+        transformArray(L, t, false, in, out, count);
+    }
+
+    void transformNormals(const Affine &a, const float3 *in, float3 *out, size_t count)
+    {
+        // Rows of the inverse transpose are the columns of the inverse.
+        const Affine inv = a.inverse();
+        const float *m = inv.m;
+        const float L[9] = {m[0], m[4], m[8], m[1], m[5], m[9], m[2], m[6], m[10]};
+        const float t[3] = {0.0f, 0.0f, 0.0f};
+        transformArray(L, t, true, in, out, count);
+    }
+
+    void transformMesh(TriangleMesh &mesh, const Affine &a)
+    {
+        transformPoints(a, mesh.vertex);
+        transformNormals(a, mesh.normal);
+        // Connectivity is unchanged; lengths are not under scaling.
+        mesh.edgeStatsCache.reset();
+    }
+}
@@ -511,26 +511,17 @@ Object_t::Object_t(const std::string &filename)
 }
 
 
-void Transform_t::getTRS(float *trs)
+void Transform_t::getTRS(float *trs) const
 {
+    // quat2rom is column-major: R(i, j) = rotMat[3 * j + i]; trs is row-major with scale on the columns.
     float rotMat[9];
-    quat2rom(rotation, rotMat);
-
-    // Apply scaling to rotation matrix
-    rotMat[0] *= scale.x;
-    rotMat[1] *= scale.y;
-    rotMat[2] *= scale.z;
-    rotMat[3] *= scale.x;
-    rotMat[4] *= scale.y;
-    rotMat[5] *= scale.z;
-    rotMat[6] *= scale.x;
-    rotMat[7] *= scale.y;
-    rotMat[8] *= scale.z;
-
-    float transforms[12] = {
-        rotMat[0], rotMat[1], rotMat[2], position.x,
-        rotMat[3], rotMat[4], rotMat[5], position.y,
-        rotMat[6], rotMat[7], rotMat[8], position.z};
-
-    memcpy(trs, transforms, sizeof(float) * 12);
+    quat2rom(normalize(rotation), rotMat);
+    const float s[3] = {scale.x, scale.y, scale.z};
+    const float p[3] = {position.x, position.y, position.z};
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+            trs[4 * i + j] = rotMat[3 * j + i] * s[j];
+        trs[4 * i + 3] = p[i];
+    }
 }
@@ -0,0 +1,105 @@
+#include "RegionOfInterest.h"
+#include "HostParallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace SPIN
+{
+    std::vector<uint32_t> selectRoiVertices(const TriangleMesh &target, const RegionOfInterest &roi)
+    {
+        const size_t numVertices = target.vertex.size();
+        switch (roi.type)
+        {
+        case RegionOfInterest::Type::VERTICES:
+        {
+            std::vector<uint32_t> ids;
+            ids.reserve(roi.vertices.size());
+            for (uint32_t v : roi.vertices)
+                if (v < numVertices)
+                    ids.push_back(v);
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+            return ids;
+        }
+        case RegionOfInterest::Type::BOX:
+        case RegionOfInterest::Type::ORIENTED_BOX:
+            return parallelSelect(numVertices, [&](size_t i) { return roi.contains(target.vertex[i]); });
+        default:
+            return parallelSelect(numVertices, [](size_t) { return true; });
+        }
+    }
+
+    std::vector<uint32_t> cullTriangles(const TriangleMesh &source, const float3 &lo, const float3 &hi)
+    {
+        return parallelSelect(source.index.size(), [&](size_t i) {
+            const uint3 idx = source.index[i];
+            const float3 &v0 = source.vertex[idx.x];
+            const float3 &v1 = source.vertex[idx.y];
+            const float3 &v2 = source.vertex[idx.z];
+            const float3 tLo = fminf(v0, fminf(v1, v2));
+            const float3 tHi = fmaxf(v0, fmaxf(v1, v2));
+            return tLo.x <= hi.x && tLo.y <= hi.y && tLo.z <= hi.z &&
+                   tHi.x >= lo.x && tHi.y >= lo.y && tHi.z >= lo.z;
+        });
+    }
+
+    void closestPointCullBox(const TriangleMesh &source, const TriangleMesh &target, const std::vector<uint32_t> &queries,
+                             float maxDistance, float3 &lo, float3 &hi, const Affine &targetToSource)
+    {
+        lo = make_float3(INFINITY, INFINITY, INFINITY);
+        hi = make_float3(-INFINITY, -INFINITY, -INFINITY);
+        if (queries.empty())
+            return;
+
+        std::vector<float3> lowers(hostWorkerCount(), lo);
+        std::vector<float3> uppers(hostWorkerCount(), hi);
+        parallelFor(0, queries.size(), 16384, [&](size_t b, size_t e, unsigned worker) {
+            float3 l = lowers[worker];
+            float3 h = uppers[worker];
+            for (size_t i = b; i < e; ++i)
+            {
+                const float3 p = targetToSource.applyPoint(target.vertex[queries[i]]);
+                l = fminf(l, p);
+                h = fmaxf(h, p);
+            }
+            lowers[worker] = l;
+            uppers[worker] = h;
+        });
+        for (size_t w = 0; w < lowers.size(); ++w)
+        {
+            lo = fminf(lo, lowers[w]);
+            hi = fmaxf(hi, uppers[w]);
+        }
+
+        // Every query lies within r of the box center c, and some triangle corner v lies at |c - v|,
+        // so no closest source point is farther than |c - v| + r from its query. Only corners count:
+        // a vertex no triangle references is never a closest point.
+        float radius = maxDistance;
+        if (!std::isfinite(radius))
+        {
+            const float3 c = 0.5f * (lo + hi);
+            const float r = 0.5f * length(hi - lo);
+            std::vector<float> nearest(hostWorkerCount(), std::numeric_limits<float>::max());
+            parallelFor(0, source.index.size(), 16384, [&](size_t b, size_t e, unsigned worker) {
+                float best = nearest[worker];
+                for (size_t i = b; i < e; ++i)
+                {
+                    const uint3 t = source.index[i];
+                    for (uint32_t v : {t.x, t.y, t.z})
+                    {
+                        const float3 d = source.vertex[v] - c;
+                        best = std::min(best, dot(d, d));
+                    }
+                }
+                nearest[worker] = best;
+            });
+            radius = std::sqrt(*std::min_element(nearest.begin(), nearest.end())) + r;
+        }
+
+        const float3 pad = make_float3(radius, radius, radius);
+        lo = lo - pad;
+        hi = hi + pad;
+    }
+}
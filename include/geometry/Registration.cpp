@@ -0,0 +1,779 @@
+#include "Registration.h"
+#include "HostParallel.h"
+#include "HostTriangleBVH.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+    // Normal equations of the linearized point-to-plane problem in (omega, t), upper triangle row by row.
+    struct NormalEquations
+    {
+        double a[21] = {};
+        double b[6] = {};
+        double residual2 = 0.0;
+        size_t count = 0;
+
+        void add(const float3 &arm, const float3 &n, float r)
+        {
+            const float3 c = cross(arm, n);
+            const double j[6] = {c.x, c.y, c.z, n.x, n.y, n.z};
+            int k = 0;
+            for (int row = 0; row < 6; ++row)
+            {
+                for (int col = row; col < 6; ++col)
+                    a[k++] += j[row] * j[col];
+                b[row] -= j[row] * r;
+            }
+            residual2 += static_cast<double>(r) * r;
+            ++count;
+        }
+
+        void merge(const NormalEquations &o)
+        {
+            for (int k = 0; k < 21; ++k)
+                a[k] += o.a[k];
+            for (int k = 0; k < 6; ++k)
+                b[k] += o.b[k];
+            residual2 += o.residual2;
+            count += o.count;
+        }
+
+        // Gaussian elimination with partial pivoting; a small ridge keeps flat or symmetric parts
+        // (planes, cylinders) from sliding along their unconstrained directions.
+        bool solve(double x[6]) const
+        {
+            double m[6][7];
+            int k = 0;
+            for (int row = 0; row < 6; ++row)
+                for (int col = row; col < 6; ++col)
+                    m[row][col] = m[col][row] = a[k++];
+            double trace = 0.0;
+            for (int i = 0; i < 6; ++i)
+                trace += m[i][i];
+            for (int i = 0; i < 6; ++i)
+            {
+                m[i][i] += 1e-9 * trace;
+                m[i][6] = b[i];
+            }
+            for (int c = 0; c < 6; ++c)
+            {
+                int pivot = c;
+                for (int r = c + 1; r < 6; ++r)
+                    if (std::fabs(m[r][c]) > std::fabs(m[pivot][c]))
+                        pivot = r;
+                if (!(std::fabs(m[pivot][c]) > 0.0))
+                    return false;
+                if (pivot != c)
+                    for (int j = 0; j < 7; ++j)
+                        std::swap(m[c][j], m[pivot][j]);
+                for (int r = c + 1; r < 6; ++r)
+                {
+                    const double f = m[r][c] / m[c][c];
+                    for (int j = c; j < 7; ++j)
+                        m[r][j] -= f * m[c][j];
+                }
+            }
+            for (int r = 5; r >= 0; --r)
+            {
+                double s = m[r][6];
+                for (int j = r + 1; j < 6; ++j)
+                    s -= m[r][j] * x[j];
+                x[r] = s / m[r][r];
+            }
+            return true;
+        }
+    };
+
+    constexpr uint32_t kMaxCellsPerAxis = 1024; // linear cell codes fit in 30 bits
+    constexpr int kFeatureBins = 11;
+    constexpr int kFeatureSize = 3 * kFeatureBins;
+    using Feature = std::array<float, kFeatureSize>;
+
+    struct Bounds
+    {
+        float3 lo = {INFINITY, INFINITY, INFINITY};
+        float3 hi = {-INFINITY, -INFINITY, -INFINITY};
+        double area = 0.0;
+    };
+
+    Bounds meshBounds(const TriangleMesh &mesh)
+    {
+        std::vector<Bounds> partial(SPIN::hostWorkerCount());
+        SPIN::parallelFor(0, mesh.vertex.size(), 65536, [&](size_t b, size_t e, unsigned worker) {
+            for (size_t v = b; v < e; ++v)
+            {
+                partial[worker].lo = fminf(partial[worker].lo, mesh.vertex[v]);
+                partial[worker].hi = fmaxf(partial[worker].hi, mesh.vertex[v]);
+            }
+        });
+        SPIN::parallelFor(0, mesh.index.size(), 65536, [&](size_t b, size_t e, unsigned worker) {
+            for (size_t f = b; f < e; ++f)
+            {
+                const uint3 t = mesh.index[f];
+                partial[worker].area += 0.5 * length(cross(mesh.vertex[t.y] - mesh.vertex[t.x], mesh.vertex[t.z] - mesh.vertex[t.x]));
+            }
+        });
+        Bounds total;
+        for (const Bounds &p : partial)
+        {
+            total.lo = fminf(total.lo, p.lo);
+            total.hi = fmaxf(total.hi, p.hi);
+            total.area += p.area;
+        }
+        return total;
+    }
+
+    // Uniform grid over [lo, lo + cell * dims) with linear cell codes.
+    struct Grid
+    {
+        float3 lo;
+        float cell;
+        uint32_t dimX, dimY, dimZ;
+
+        Grid(const float3 &lower, const float3 &upper, float cellSize)
+        {
+            const float3 extent = upper - lower;
+            const float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+            cell = std::max(cellSize, maxExtent / static_cast<float>(kMaxCellsPerAxis - 1));
+            if (!(cell > 0.0f))
+                cell = 1.0f;
+            lo = lower;
+            dimX = std::min(kMaxCellsPerAxis, static_cast<uint32_t>(extent.x / cell) + 1);
+            dimY = std::min(kMaxCellsPerAxis, static_cast<uint32_t>(extent.y / cell) + 1);
+            dimZ = std::min(kMaxCellsPerAxis, static_cast<uint32_t>(extent.z / cell) + 1);
+        }
+
+        int3 coords(const float3 &p) const
+        {
+            const float3 rel = (p - lo) / cell;
+            return make_int3(static_cast<int>(std::floor(rel.x)), static_cast<int>(std::floor(rel.y)), static_cast<int>(std::floor(rel.z)));
+        }
+        uint32_t code(int3 c) const
+        {
+            c.x = std::min(static_cast<int>(dimX) - 1, std::max(0, c.x));
+            c.y = std::min(static_cast<int>(dimY) - 1, std::max(0, c.y));
+            c.z = std::min(static_cast<int>(dimZ) - 1, std::max(0, c.z));
+            return static_cast<uint32_t>(c.x) + dimX * (static_cast<uint32_t>(c.y) + dimY * static_cast<uint32_t>(c.z));
+        }
+        uint32_t code(const float3 &p) const { return code(coords(p)); }
+    };
+
+    struct PointSet
+    {
+        std::vector<float3> point;
+        std::vector<float3> normal; // unit, or zero when the voxel had no usable normal
+    };
+
+    // One point per occupied voxel: mean vertex position, and the mean vertex normal (or the summed
+    // normals of the faces whose first corner lies in the voxel when the mesh has no normals).
+    PointSet voxelDownsample(const TriangleMesh &mesh, const Grid &grid)
+    {
+        const size_t numVertices = mesh.vertex.size();
+        std::vector<uint64_t> keys(numVertices);
+        SPIN::parallelFor(0, numVertices, 65536, [&](size_t b, size_t e, unsigned) {
+            for (size_t v = b; v < e; ++v)
+                keys[v] = (uint64_t(v) << 32) | grid.code(mesh.vertex[v]);
+        });
+        SPIN::parallelRadixSort(keys, 30);
+        std::vector<uint32_t> runStart = SPIN::parallelSelect(numVertices, [&](size_t k) {
+            return k == 0 || static_cast<uint32_t>(keys[k]) != static_cast<uint32_t>(keys[k - 1]);
+        });
+        const size_t numVoxels = runStart.size();
+        runStart.push_back(static_cast<uint32_t>(numVertices));
+
+        std::vector<uint32_t> voxelOf(numVertices);
+        PointSet out;
+        out.point.resize(numVoxels);
+        out.normal.assign(numVoxels, make_float3(0.0f, 0.0f, 0.0f));
+        const bool vertexNormals = mesh.normal.size() == numVertices;
+        SPIN::parallelFor(0, numVoxels, 1024, [&](size_t b, size_t e, unsigned) {
+            for (size_t c = b; c < e; ++c)
+            {
+                double sx = 0.0, sy = 0.0, sz = 0.0;
+                float3 n = make_float3(0.0f, 0.0f, 0.0f);
+                for (uint32_t k = runStart[c]; k < runStart[c + 1]; ++k)
+                {
+                    const uint32_t v = static_cast<uint32_t>(keys[k] >> 32);
+                    voxelOf[v] = static_cast<uint32_t>(c);
+                    sx += mesh.vertex[v].x;
+                    sy += mesh.vertex[v].y;
+                    sz += mesh.vertex[v].z;
+                    if (vertexNormals)
+                        n += mesh.normal[v];
+                }
+                const double inv = 1.0 / static_cast<double>(runStart[c + 1] - runStart[c]);
+                out.point[c] = make_float3(static_cast<float>(sx * inv), static_cast<float>(sy * inv), static_cast<float>(sz * inv));
+                out.normal[c] = n;
+            }
+        });
+
+        if (!vertexNormals && !mesh.index.empty())
+        {
+            const size_t numFaces = mesh.index.size();
+            std::vector<uint64_t> faceKeys(numFaces);
+            SPIN::parallelFor(0, numFaces, 65536, [&](size_t b, size_t e, unsigned) {
+                for (size_t f = b; f < e; ++f)
+                    faceKeys[f] = (uint64_t(f) << 32) | voxelOf[mesh.index[f].x];
+            });
+            SPIN::parallelRadixSort(faceKeys, 30);
+            std::vector<uint32_t> faceRuns = SPIN::parallelSelect(numFaces, [&](size_t k) {
+                return k == 0 || static_cast<uint32_t>(faceKeys[k]) != static_cast<uint32_t>(faceKeys[k - 1]);
+            });
+            const size_t numRuns = faceRuns.size();
+            faceRuns.push_back(static_cast<uint32_t>(numFaces));
+            SPIN::parallelFor(0, numRuns, 1024, [&](size_t b, size_t e, unsigned) {
+                for (size_t r = b; r < e; ++r)
+                {
+                    float3 n = make_float3(0.0f, 0.0f, 0.0f);
+                    for (uint32_t k = faceRuns[r]; k < faceRuns[r + 1]; ++k)
+                    {
+                        const uint3 t = mesh.index[faceKeys[k] >> 32];
+                        n += cross(mesh.vertex[t.y] - mesh.vertex[t.x], mesh.vertex[t.z] - mesh.vertex[t.x]);
+                    }
+                    out.normal[static_cast<uint32_t>(faceKeys[faceRuns[r]])] = n;
+                }
+            });
+        }
+
+        SPIN::parallelFor(0, numVoxels, 4096, [&](size_t b, size_t e, unsigned) {
+            for (size_t c = b; c < e; ++c)
+            {
+                const float len = length(out.normal[c]);
+                out.normal[c] = len > 0.0f ? out.normal[c] / len : make_float3(0.0f, 0.0f, 0.0f);
+            }
+        });
+        return out;
+    }
+
+    // Fixed-radius neighbour queries over a point set (grid cell = radius, 27-cell search).
+    class PointIndex
+    {
+    public:
+        PointIndex(const std::vector<float3> &points, const float3 &lo, const float3 &hi, float radius)
+            : m_points(points), m_grid(lo, hi, radius), m_radius(radius)
+        {
+            m_keys.resize(points.size());
+            SPIN::parallelFor(0, points.size(), 65536, [&](size_t b, size_t e, unsigned) {
+                for (size_t i = b; i < e; ++i)
+                    m_keys[i] = (uint64_t(i) << 32) | m_grid.code(points[i]);
+            });
+            SPIN::parallelRadixSort(m_keys, 30);
+        }
+
+        // f(index, distance) for every point within the radius of p other than skip.
+        template <typename F>
+        void forEachNeighbor(const float3 &p, uint32_t skip, F &&f) const
+        {
+            const int3 c = m_grid.coords(p);
+            for (int dz = -1; dz <= 1; ++dz)
+                for (int dy = -1; dy <= 1; ++dy)
+                    for (int dx = -1; dx <= 1; ++dx)
+                    {
+                        const int3 n = make_int3(c.x + dx, c.y + dy, c.z + dz);
+                        if (n.x < 0 || n.y < 0 || n.z < 0 || n.x >= static_cast<int>(m_grid.dimX) ||
+                            n.y >= static_cast<int>(m_grid.dimY) || n.z >= static_cast<int>(m_grid.dimZ))
+                            continue;
+                        const uint32_t code = m_grid.code(n);
+                        auto it = std::lower_bound(m_keys.begin(), m_keys.end(), code,
+                                                   [](uint64_t key, uint32_t c) { return static_cast<uint32_t>(key) < c; });
+                        for (; it != m_keys.end() && static_cast<uint32_t>(*it) == code; ++it)
+                        {
+                            const uint32_t i = static_cast<uint32_t>(*it >> 32);
+                            if (i == skip)
+                                continue;
+                            const float d = length(m_points[i] - p);
+                            if (d <= m_radius)
+                                f(i, d);
+                        }
+                    }
+        }
+
+    private:
+        const std::vector<float3> &m_points;
+        Grid m_grid;
+        float m_radius;
+        std::vector<uint64_t> m_keys; // point index high, cell code low; sorted by cell
+    };
+
+    int featureBin(float x, float lo, float hi)
+    {
+        const int b = static_cast<int>((x - lo) / (hi - lo) * kFeatureBins);
+        return std::min(kFeatureBins - 1, std::max(0, b));
+    }
+
+    // Fast point feature histograms: per-point histograms of the Darboux-frame angles to each neighbour
+    // (SPFH), then each point adds the distance-weighted SPFH of its neighbours.
+    std::vector<Feature> computeFpfh(const PointSet &points, const PointIndex &index)
+    {
+        const size_t n = points.point.size();
+        std::vector<Feature> spfh(n);
+        SPIN::parallelFor(0, n, 256, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+            {
+                Feature &h = spfh[i];
+                h.fill(0.0f);
+                const float3 p = points.point[i], u = points.normal[i];
+                if (length(u) == 0.0f)
+                    continue;
+                int count = 0;
+                index.forEachNeighbor(p, static_cast<uint32_t>(i), [&](uint32_t j, float d) {
+                    const float3 nq = points.normal[j];
+                    if (d <= 0.0f || length(nq) == 0.0f)
+                        return;
+                    const float3 dir = (points.point[j] - p) / d;
+                    float3 v = cross(dir, u);
+                    const float vLen = length(v);
+                    if (!(vLen > 0.0f))
+                        return;
+                    v /= vLen;
+                    const float3 w = cross(u, v);
+                    ++h[featureBin(dot(v, nq), -1.0f, 1.0f)];
+                    ++h[kFeatureBins + featureBin(dot(u, dir), -1.0f, 1.0f)];
+                    ++h[2 * kFeatureBins + featureBin(std::atan2(dot(w, nq), dot(u, nq)), -3.14159265f, 3.14159265f)];
+                    ++count;
+                });
+                if (count > 0)
+                    for (float &x : h)
+                        x *= 100.0f / static_cast<float>(count);
+            }
+        });
+
+        std::vector<Feature> fpfh(n);
+        SPIN::parallelFor(0, n, 256, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+            {
+                Feature acc;
+                acc.fill(0.0f);
+                float weightSum = 0.0f;
+                index.forEachNeighbor(points.point[i], static_cast<uint32_t>(i), [&](uint32_t j, float d) {
+                    if (d <= 0.0f)
+                        return;
+                    const float w = 1.0f / d;
+                    for (int k = 0; k < kFeatureSize; ++k)
+                        acc[k] += w * spfh[j][k];
+                    weightSum += w;
+                });
+                Feature &f = fpfh[i];
+                for (int k = 0; k < kFeatureSize; ++k)
+                    f[k] = spfh[i][k] + (weightSum > 0.0f ? acc[k] / weightSum : 0.0f);
+                // Each angle histogram sums to 100.
+                for (int block = 0; block < 3; ++block)
+                {
+                    float sum = 0.0f;
+                    for (int k = 0; k < kFeatureBins; ++k)
+                        sum += f[block * kFeatureBins + k];
+                    if (sum > 0.0f)
+                        for (int k = 0; k < kFeatureBins; ++k)
+                            f[block * kFeatureBins + k] *= 100.0f / sum;
+                }
+            }
+        });
+        return fpfh;
+    }
+
+    // Nearest descriptor in to for every descriptor in from (brute force, parallel).
+    std::vector<uint32_t> nearestFeatures(const std::vector<Feature> &from, const std::vector<Feature> &to)
+    {
+        std::vector<uint32_t> nearest(from.size(), 0);
+        SPIN::parallelFor(0, from.size(), 64, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+            {
+                float best = INFINITY;
+                for (size_t j = 0; j < to.size(); ++j)
+                {
+                    float d = 0.0f;
+                    for (int k = 0; k < kFeatureSize && d < best; ++k)
+                    {
+                        const float diff = from[i][k] - to[j][k];
+                        d += diff * diff;
+                    }
+                    if (d < best)
+                    {
+                        best = d;
+                        nearest[i] = static_cast<uint32_t>(j);
+                    }
+                }
+            }
+        });
+        return nearest;
+    }
+
+    // Least-squares rotation and translation taking from[i] to to[i] (Horn's quaternion method).
+    bool fitRigid(const float3 *from, const float3 *to, size_t n, SPIN::Affine &out)
+    {
+        if (n < 3)
+            return false;
+        double ca[3] = {0, 0, 0}, cb[3] = {0, 0, 0};
+        for (size_t i = 0; i < n; ++i)
+        {
+            ca[0] += from[i].x, ca[1] += from[i].y, ca[2] += from[i].z;
+            cb[0] += to[i].x, cb[1] += to[i].y, cb[2] += to[i].z;
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            ca[k] /= static_cast<double>(n);
+            cb[k] /= static_cast<double>(n);
+        }
+        double s[3][3] = {};
+        for (size_t i = 0; i < n; ++i)
+        {
+            const double a[3] = {from[i].x - ca[0], from[i].y - ca[1], from[i].z - ca[2]};
+            const double b[3] = {to[i].x - cb[0], to[i].y - cb[1], to[i].z - cb[2]};
+            for (int r = 0; r < 3; ++r)
+                for (int c = 0; c < 3; ++c)
+                    s[r][c] += a[r] * b[c];
+        }
+        double m[4][4] = {
+            {s[0][0] + s[1][1] + s[2][2], s[1][2] - s[2][1], s[2][0] - s[0][2], s[0][1] - s[1][0]},
+            {s[1][2] - s[2][1], s[0][0] - s[1][1] - s[2][2], s[0][1] + s[1][0], s[2][0] + s[0][2]},
+            {s[2][0] - s[0][2], s[0][1] + s[1][0], s[1][1] - s[0][0] - s[2][2], s[1][2] + s[2][1]},
+            {s[0][1] - s[1][0], s[2][0] + s[0][2], s[1][2] + s[2][1], s[2][2] - s[0][0] - s[1][1]}};
+
+        // Cyclic Jacobi; the eigenvector of the largest eigenvalue is the rotation (w, x, y, z).
+        double v[4][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+        for (int sweep = 0; sweep < 32; ++sweep)
+        {
+            double off = 0.0;
+            for (int p = 0; p < 4; ++p)
+                for (int q = p + 1; q < 4; ++q)
+                    off += m[p][q] * m[p][q];
+            if (off < 1e-24)
+                break;
+            for (int p = 0; p < 4; ++p)
+                for (int q = p + 1; q < 4; ++q)
+                {
+                    if (m[p][q] == 0.0)
+                        continue;
+                    const double theta = (m[q][q] - m[p][p]) / (2.0 * m[p][q]);
+                    const double t = (theta >= 0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                    const double c = 1.0 / std::sqrt(t * t + 1.0), sn = t * c;
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        const double mkp = m[k][p], mkq = m[k][q];
+                        m[k][p] = c * mkp - sn * mkq;
+                        m[k][q] = sn * mkp + c * mkq;
+                    }
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        const double mpk = m[p][k], mqk = m[q][k];
+                        m[p][k] = c * mpk - sn * mqk;
+                        m[q][k] = sn * mpk + c * mqk;
+                    }
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        const double vkp = v[k][p], vkq = v[k][q];
+                        v[k][p] = c * vkp - sn * vkq;
+                        v[k][q] = sn * vkp + c * vkq;
+                    }
+                }
+        }
+        int best = 0;
+        for (int k = 1; k < 4; ++k)
+            if (m[k][k] > m[best][best])
+                best = k;
+        const double w = v[0][best], x = v[1][best], y = v[2][best], z = v[3][best];
+        const double r[9] = {w * w + x * x - y * y - z * z, 2 * (x * y - w * z), 2 * (x * z + w * y),
+                             2 * (x * y + w * z), w * w - x * x + y * y - z * z, 2 * (y * z - w * x),
+                             2 * (x * z - w * y), 2 * (y * z + w * x), w * w - x * x - y * y + z * z};
+        for (int row = 0; row < 3; ++row)
+        {
+            out.m[4 * row + 0] = static_cast<float>(r[3 * row + 0]);
+            out.m[4 * row + 1] = static_cast<float>(r[3 * row + 1]);
+            out.m[4 * row + 2] = static_cast<float>(r[3 * row + 2]);
+            out.m[4 * row + 3] = static_cast<float>(cb[row] - (r[3 * row + 0] * ca[0] + r[3 * row + 1] * ca[1] + r[3 * row + 2] * ca[2]));
+        }
+        return true;
+    }
+}
+
+namespace SPIN
+{
+    IcpResult alignIcp(const HostTriangleBVH &sourceBVH, const TriangleMesh &source, const TriangleMesh &target,
+                       const IcpOptions &options, const Affine &initial)
+    {
+        IcpResult result;
+        result.transform = initial;
+        if (sourceBVH.empty() || target.vertex.empty())
+            return result;
+
+        // Stratified subsample: every stride-th vertex, starting mid-stride.
+        const size_t numVertices = target.vertex.size();
+        const size_t stride = (options.maxSamples > 0 && numVertices > options.maxSamples)
+                                  ? (numVertices + options.maxSamples - 1) / options.maxSamples
+                                  : 1;
+        std::vector<uint32_t> samples;
+        samples.reserve(numVertices / stride + 1);
+        for (size_t v = stride / 2; v < numVertices; v += stride)
+            if (std::isfinite(target.vertex[v].x) && std::isfinite(target.vertex[v].y) && std::isfinite(target.vertex[v].z))
+                samples.push_back(static_cast<uint32_t>(v));
+
+        const size_t numSamples = samples.size();
+        std::vector<float3> original(numSamples), moved(numSamples), normal(numSamples);
+        for (size_t i = 0; i < numSamples; ++i)
+            original[i] = target.vertex[samples[i]];
+        std::vector<float> residual(numSamples), distance(numSamples);
+        std::vector<float> kept;
+        const float diagonal = sourceBVH.diagonal();
+        const unsigned workers = hostWorkerCount();
+
+        for (int iter = 0; iter < options.maxIterations; ++iter)
+        {
+            // Correspondences: closest source point and its face plane.
+            transformPoints(result.transform, original.data(), moved.data(), numSamples);
+            parallelFor(0, numSamples, 1024, [&](size_t b, size_t e, unsigned) {
+                for (size_t i = b; i < e; ++i)
+                {
+                    const float3 p = moved[i];
+                    distance[i] = INFINITY;
+                    const ClosestHit hit = sourceBVH.closestPoint(p, options.maxCorrespondenceDistance);
+                    if (!hit.valid())
+                        continue;
+                    const uint3 t = source.index[hit.triangle];
+                    const float3 n = cross(source.vertex[t.y] - source.vertex[t.x], source.vertex[t.z] - source.vertex[t.x]);
+                    const float len = length(n);
+                    if (!(len > 0.0f))
+                        continue;
+                    normal[i] = n / len;
+                    residual[i] = dot(p - hit.point, normal[i]);
+                    distance[i] = hit.distance;
+                }
+            });
+
+            // Trimming: drop the largest distances.
+            kept.clear();
+            for (float d : distance)
+                if (std::isfinite(d))
+                    kept.push_back(d);
+            if (kept.size() < 6)
+                break;
+            const size_t keep = std::max<size_t>(6, static_cast<size_t>(std::ceil((1.0 - options.trimFraction) * kept.size())));
+            float threshold = INFINITY;
+            if (keep < kept.size())
+            {
+                std::nth_element(kept.begin(), kept.begin() + (keep - 1), kept.end());
+                threshold = kept[keep - 1];
+            }
+
+            // Linearize about the centroid of the kept points for a well-conditioned system.
+            struct Sum
+            {
+                double x = 0.0, y = 0.0, z = 0.0;
+                size_t count = 0;
+            };
+            std::vector<Sum> sums(workers);
+            parallelFor(0, numSamples, 4096, [&](size_t b, size_t e, unsigned worker) {
+                for (size_t i = b; i < e; ++i)
+                    if (distance[i] <= threshold)
+                    {
+                        sums[worker].x += moved[i].x;
+                        sums[worker].y += moved[i].y;
+                        sums[worker].z += moved[i].z;
+                        ++sums[worker].count;
+                    }
+            });
+            Sum total;
+            for (const Sum &w : sums)
+            {
+                total.x += w.x;
+                total.y += w.y;
+                total.z += w.z;
+                total.count += w.count;
+            }
+            const double invCount = 1.0 / static_cast<double>(total.count);
+            const float3 center = make_float3(static_cast<float>(total.x * invCount), static_cast<float>(total.y * invCount),
+                                              static_cast<float>(total.z * invCount));
+
+            std::vector<NormalEquations> partial(workers);
+            parallelFor(0, numSamples, 4096, [&](size_t b, size_t e, unsigned worker) {
+                for (size_t i = b; i < e; ++i)
+                    if (distance[i] <= threshold)
+                        partial[worker].add(moved[i] - center, normal[i], residual[i]);
+            });
+            NormalEquations eq;
+            for (const NormalEquations &p : partial)
+                eq.merge(p);
+
+            result.rms = static_cast<float>(std::sqrt(eq.residual2 / static_cast<double>(eq.count)));
+            result.inliers = eq.count;
+            result.iterations = iter + 1;
+
+            double x[6];
+            if (!eq.solve(x))
+                break;
+            const float3 omega = make_float3(static_cast<float>(x[0]), static_cast<float>(x[1]), static_cast<float>(x[2]));
+            const float3 shift = make_float3(static_cast<float>(x[3]), static_cast<float>(x[4]), static_cast<float>(x[5]));
+            const float angle = length(omega);
+
+            // Rotate about the centroid, then translate: T <- (c + t) R (-c) T.
+            Affine step = Affine::rigid(angle > 0.0f ? omega / angle : make_float3(1.0f, 0.0f, 0.0f), angle, make_float3(0.0f, 0.0f, 0.0f));
+            const float3 offset = center + shift - step.applyLinear(center);
+            step.m[3] = offset.x;
+            step.m[7] = offset.y;
+            step.m[11] = offset.z;
+            result.transform = step * result.transform;
+
+            if (angle < options.rotationTolerance && length(shift) < options.translationTolerance * diagonal)
+            {
+                result.converged = true;
+                break;
+            }
+        }
+        return result;
+    }
+
+    GlobalRegistrationResult registerGlobal(const TriangleMesh &source, const TriangleMesh &target,
+                                            const GlobalRegistrationOptions &options)
+    {
+        GlobalRegistrationResult result;
+        if (source.vertex.empty() || target.vertex.empty())
+            return result;
+
+        const Bounds sourceBounds = meshBounds(source);
+        const Bounds targetBounds = meshBounds(target);
+        float voxel = options.voxelSize;
+        if (!(voxel > 0.0f))
+        {
+            // A surface crossing k voxels leaves about k points.
+            const float diagonal = length(sourceBounds.hi - sourceBounds.lo);
+            const double area = sourceBounds.area > 0.0 ? sourceBounds.area : static_cast<double>(diagonal) * diagonal;
+            voxel = static_cast<float>(std::sqrt(area / static_cast<double>(std::max<size_t>(1, options.targetPoints))));
+        }
+        const PointSet sourcePoints = voxelDownsample(source, Grid(sourceBounds.lo, sourceBounds.hi, voxel));
+        const PointSet targetPoints = voxelDownsample(target, Grid(targetBounds.lo, targetBounds.hi, voxel));
+        result.sourcePoints = sourcePoints.point.size();
+        result.targetPoints = targetPoints.point.size();
+
+        const float radius = options.featureRadius * voxel;
+        const PointIndex sourceIndex(sourcePoints.point, sourceBounds.lo, sourceBounds.hi, radius);
+        const PointIndex targetIndex(targetPoints.point, targetBounds.lo, targetBounds.hi, radius);
+        const std::vector<Feature> sourceFeatures = computeFpfh(sourcePoints, sourceIndex);
+        const std::vector<Feature> targetFeatures = computeFpfh(targetPoints, targetIndex);
+
+        // Matches as (target point, source point).
+        const std::vector<uint32_t> toSource = nearestFeatures(targetFeatures, sourceFeatures);
+        std::vector<float3> from, to;
+        if (options.mutualFilter)
+        {
+            const std::vector<uint32_t> toTarget = nearestFeatures(sourceFeatures, targetFeatures);
+            for (size_t i = 0; i < toSource.size(); ++i)
+                if (toTarget[toSource[i]] == i)
+                {
+                    from.push_back(targetPoints.point[i]);
+                    to.push_back(sourcePoints.point[toSource[i]]);
+                }
+        }
+        // Too few mutual matches to sample from: fall back to the one-sided ones.
+        if (from.size() < 10)
+        {
+            from.clear();
+            to.clear();
+            for (size_t i = 0; i < toSource.size(); ++i)
+            {
+                from.push_back(targetPoints.point[i]);
+                to.push_back(sourcePoints.point[toSource[i]]);
+            }
+        }
+        const size_t numMatches = from.size();
+        result.correspondences = numMatches;
+        if (numMatches < 3)
+            return result;
+
+        const float inlierDistance = options.inlierDistance * voxel;
+        auto countInliers = [&](const Affine &t) {
+            size_t count = 0;
+            for (size_t i = 0; i < numMatches; ++i)
+                count += length(t.applyPoint(from[i]) - to[i]) <= inlierDistance;
+            return count;
+        };
+
+        // RANSAC in fixed chunks with per-chunk seeds: the result does not depend on the worker count.
+        constexpr size_t kChunk = 256;
+        const size_t iterations = static_cast<size_t>(std::max(0, options.ransacIterations));
+        const size_t numChunks = (iterations + kChunk - 1) / kChunk;
+        struct Best
+        {
+            size_t inliers = 0;
+            Affine transform;
+        };
+        std::vector<Best> chunkBest(numChunks);
+        parallelFor(0, numChunks, 1, [&](size_t b, size_t e, unsigned) {
+            for (size_t chunk = b; chunk < e; ++chunk)
+            {
+                std::mt19937 rng(options.seed * 0x9E3779B9u + static_cast<uint32_t>(chunk));
+                std::uniform_int_distribution<size_t> pick(0, numMatches - 1);
+                const size_t end = std::min(iterations, (chunk + 1) * kChunk);
+                for (size_t it = chunk * kChunk; it < end; ++it)
+                {
+                    const size_t s[3] = {pick(rng), pick(rng), pick(rng)};
+                    if (s[0] == s[1] || s[1] == s[2] || s[0] == s[2])
+                        continue;
+                    // A rigid motion keeps the triangle's edge lengths.
+                    bool similar = true;
+                    for (int k = 0; k < 3 && similar; ++k)
+                    {
+                        const float a = length(from[s[k]] - from[s[(k + 1) % 3]]);
+                        const float c = length(to[s[k]] - to[s[(k + 1) % 3]]);
+                        similar = std::min(a, c) >= options.edgeLengthRatio * std::max(a, c) && a > 0.0f;
+                    }
+                    if (!similar)
+                        continue;
+                    const float3 f[3] = {from[s[0]], from[s[1]], from[s[2]]};
+                    const float3 g[3] = {to[s[0]], to[s[1]], to[s[2]]};
+                    Affine t;
+                    if (!fitRigid(f, g, 3, t))
+                        continue;
+                    const size_t inliers = countInliers(t);
+                    if (inliers > chunkBest[chunk].inliers)
+                        chunkBest[chunk] = {inliers, t};
+                }
+            }
+        });
+        Best best;
+        for (const Best &c : chunkBest)
+            if (c.inliers > best.inliers)
+                best = c;
+        if (best.inliers < 3)
+            return result;
+
+        // Refit on the inliers while that gains inliers.
+        std::vector<float3> inFrom, inTo;
+        for (int refine = 0; refine < 4; ++refine)
+        {
+            inFrom.clear();
+            inTo.clear();
+            for (size_t i = 0; i < numMatches; ++i)
+                if (length(best.transform.applyPoint(from[i]) - to[i]) <= inlierDistance)
+                {
+                    inFrom.push_back(from[i]);
+                    inTo.push_back(to[i]);
+                }
+            Affine refit;
+            if (!fitRigid(inFrom.data(), inTo.data(), inFrom.size(), refit))
+                break;
+            const size_t inliers = countInliers(refit);
+            if (inliers < best.inliers)
+                break;
+            const bool gained = inliers > best.inliers;
+            best = {inliers, refit};
+            if (!gained)
+                break;
+        }
+
+        double sum2 = 0.0;
+        for (size_t i = 0; i < numMatches; ++i)
+        {
+            const float d = length(best.transform.applyPoint(from[i]) - to[i]);
+            if (d <= inlierDistance)
+                sum2 += static_cast<double>(d) * d;
+        }
+        result.transform = best.transform;
+        result.inliers = best.inliers;
+        result.inlierRms = static_cast<float>(std::sqrt(sum2 / static_cast<double>(best.inliers)));
+        return result;
+    }
+}
@@ -0,0 +1,258 @@
+#include "SceneBVH.h"
+#include "HostParallel.h"
+#include "MeshTransform.h"
+
+#include "cuBQL/builder/cpu.h"
+#include "cuBQL/traversal/rayQueries.h"
+#include "cuBQL/traversal/shrinkingRadiusQuery.h"
+
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace
+{
+    inline cuBQL::vec3f toVec3f(const float3 &v) { return cuBQL::vec3f{v.x, v.y, v.z}; }
+}
+
+namespace SPIN
+{
+    std::vector<Affine> flattenScene(const Scene &scene)
+    {
+        std::unordered_map<const Instance_t *, Affine> world;
+        std::unordered_set<const Instance_t *> open;
+
+        // Walks up to the first evaluated ancestor, then composes back down the chain.
+        auto evaluate = [&](const Instance_t *leaf) {
+            std::vector<const Instance_t *> chain;
+            for (const Instance_t *i = leaf; i && world.find(i) == world.end(); i = i->parent)
+            {
+                if (!open.insert(i).second)
+                    throw std::invalid_argument("Scene hierarchy contains a parent cycle");
+                chain.push_back(i);
+            }
+            for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+            {
+                const Instance_t *i = *it;
+                const Affine local = toAffine(*i);
+                world[i] = i->parent ? world[i->parent] * local : local;
+                open.erase(i);
+            }
+            return world[leaf];
+        };
+
+        std::vector<Affine> out;
+        out.reserve(scene.hierarchy.size());
+        for (const Instance_t *instance : scene.hierarchy)
+            out.push_back(instance ? evaluate(instance) : Affine::identity());
+        return out;
+    }
+
+    TriangleMesh mergeScene(const Scene &scene, std::vector<int> *triangleMaterials)
+    {
+        const std::vector<Affine> world = flattenScene(scene);
+        std::vector<std::pair<const TriangleMesh *, size_t>> parts; // mesh, world matrix
+        size_t numVertices = 0, numTriangles = 0;
+        bool normals = true, texcoords = true;
+        for (size_t i = 0; i < scene.hierarchy.size(); ++i)
+        {
+            const Instance_t *instance = scene.hierarchy[i];
+            if (!instance || !instance->obj || !instance->obj->model)
+                continue;
+            for (const TriangleMesh *mesh : instance->obj->model->meshes)
+            {
+                if (!mesh || mesh->vertex.empty())
+                    continue;
+                parts.emplace_back(mesh, i);
+                numVertices += mesh->vertex.size();
+                numTriangles += mesh->index.size();
+                normals = normals && mesh->normal.size() == mesh->vertex.size();
+                texcoords = texcoords && mesh->texcoord.size() == mesh->vertex.size();
+            }
+        }
+
+        TriangleMesh merged;
+        merged.vertex.resize(numVertices);
+        merged.index.resize(numTriangles);
+        if (normals && !parts.empty())
+            merged.normal.resize(numVertices);
+        if (texcoords && !parts.empty())
+            merged.texcoord.resize(numVertices);
+        if (triangleMaterials)
+            triangleMaterials->resize(numTriangles);
+        size_t vertexOffset = 0, triangleOffset = 0;
+        for (const auto &part : parts)
+        {
+            const TriangleMesh &mesh = *part.first;
+            const Affine &a = world[part.second];
+            const size_t n = mesh.vertex.size();
+            transformPoints(a, mesh.vertex.data(), merged.vertex.data() + vertexOffset, n);
+            if (!merged.normal.empty())
+                transformNormals(a, mesh.normal.data(), merged.normal.data() + vertexOffset, n);
+            if (!merged.texcoord.empty())
+                std::copy(mesh.texcoord.begin(), mesh.texcoord.end(), merged.texcoord.begin() + vertexOffset);
+            if (triangleMaterials)
+                std::fill_n(triangleMaterials->begin() + triangleOffset, mesh.index.size(), mesh.materialID);
+            const uint32_t base = static_cast<uint32_t>(vertexOffset);
+            // A reflecting placement flips the winding; swapping two corners keeps the face normals outward.
+            const bool reflected = a.determinant() < 0.0f;
+            parallelFor(0, mesh.index.size(), 65536, [&](size_t b, size_t e, unsigned) {
+                for (size_t t = b; t < e; ++t)
+                {
+                    uint3 idx = mesh.index[t] + make_uint3(base, base, base);
+                    if (reflected)
+                        std::swap(idx.y, idx.z);
+                    merged.index[triangleOffset + t] = idx;
+                }
+            });
+            vertexOffset += n;
+            triangleOffset += mesh.index.size();
+        }
+        return merged;
+    }
+
+    void HostSceneBVH::build(const Scene &scene)
+    {
+        release();
+        const std::vector<Affine> world = flattenScene(scene);
+
+        std::unordered_map<const TriangleMesh *, uint32_t> blasOf;
+        std::vector<const TriangleMesh *> meshes;
+        for (size_t i = 0; i < scene.hierarchy.size(); ++i)
+        {
+            const Instance_t *instance = scene.hierarchy[i];
+            if (!instance || !instance->obj || !instance->obj->model)
+                continue;
+            SceneInstance placed;
+            placed.instance = instance;
+            placed.world = world[i];
+            if (!placed.world.similarityScale(placed.scale))
+                throw std::invalid_argument("Scene instances must be rigid up to a uniform scale");
+            placed.worldInverse = placed.world.inverse();
+            for (const TriangleMesh *mesh : instance->obj->model->meshes)
+            {
+                if (!mesh || mesh->vertex.empty() || mesh->index.empty())
+                    continue;
+                auto found = blasOf.emplace(mesh, static_cast<uint32_t>(meshes.size()));
+                if (found.second)
+                    meshes.push_back(mesh);
+                placed.mesh = mesh;
+                placed.blas = found.first->second;
+                m_instances.push_back(placed);
+            }
+        }
+        if (m_instances.empty())
+            return;
+
+        // Bottom level: one BVH per distinct mesh (each build is parallel internally).
+        m_blas.reserve(meshes.size());
+        for (const TriangleMesh *mesh : meshes)
+            m_blas.push_back(std::make_unique<HostTriangleBVH>(*mesh));
+
+        // Top level: world bounds of the transformed mesh boxes.
+        std::vector<cuBQL::box3f> boxes(m_instances.size());
+        parallelFor(0, m_instances.size(), 256, [&](size_t b, size_t e, unsigned) {
+            for (size_t i = b; i < e; ++i)
+            {
+                const SceneInstance &inst = m_instances[i];
+                const HostTriangleBVH &blas = *m_blas[inst.blas];
+                const float3 lo = blas.lower(), hi = blas.upper();
+                for (int corner = 0; corner < 8; ++corner)
+                {
+                    const float3 c = make_float3((corner & 1) ? hi.x : lo.x, (corner & 2) ? hi.y : lo.y, (corner & 4) ? hi.z : lo.z);
+                    boxes[i].extend(toVec3f(inst.world.applyPoint(c)));
+                }
+            }
+        });
+        for (const cuBQL::box3f &box : boxes)
+        {
+            m_lower = fminf(m_lower, make_float3(box.lower.x, box.lower.y, box.lower.z));
+            m_upper = fmaxf(m_upper, make_float3(box.upper.x, box.upper.y, box.upper.z));
+        }
+        cuBQL::cpuBuilder(m_tlas, boxes.data(), static_cast<uint32_t>(boxes.size()), cuBQL::BuildConfig());
+        m_built = true;
+    }
+
+    void HostSceneBVH::release()
+    {
+        if (m_built)
+            cuBQL::cpu::freeBVH(m_tlas);
+        m_tlas = cuBQL::bvh3f{};
+        m_built = false;
+        m_blas.clear();
+        m_instances.clear();
+        m_lower = make_float3(INFINITY, INFINITY, INFINITY);
+        m_upper = make_float3(-INFINITY, -INFINITY, -INFINITY);
+    }
+
+    ClosestHit HostSceneBVH::closestPoint(const float3 &p, float maxDistance) const
+    {
+        ClosestHit best;
+        if (!m_built)
+            return best;
+
+        // Each instance is searched in its own frame, bounded by the best world distance so far.
+        float maxDist2 = maxDistance * maxDistance;
+        auto onInstance = [&](uint32_t primID) -> float {
+            const SceneInstance &inst = m_instances[primID];
+            const ClosestHit hit = m_blas[inst.blas]->closestPoint(inst.worldInverse.applyPoint(p), std::sqrt(maxDist2) / inst.scale);
+            if (hit.valid())
+            {
+                const float d = hit.distance * inst.scale;
+                if (d * d < maxDist2 || !best.valid())
+                {
+                    maxDist2 = std::min(maxDist2, d * d);
+                    best = hit;
+                    best.distance = d;
+                    best.point = inst.world.applyPoint(hit.point);
+                    best.instance = static_cast<int>(primID);
+                }
+            }
+            return maxDist2;
+        };
+        cuBQL::shrinkingRadiusQuery::forEachPrim(onInstance, m_tlas, toVec3f(p), maxDist2);
+        return best;
+    }
+
+    RayHit HostSceneBVH::intersect(const float3 &origin, const float3 &dir, float maxDistance) const
+    {
+        RayHit best;
+        if (!m_built)
+            return best;
+
+        cuBQL::ray3f ray;
+        ray.origin = toVec3f(origin);
+        ray.direction = toVec3f(dir);
+        ray.tMin = 0.0f;
+        ray.tMax = maxDistance;
+
+        // The direction is mapped without renormalizing, so ray parameters are the same in both frames.
+        auto onInstance = [&](uint32_t primID) -> float {
+            const SceneInstance &inst = m_instances[primID];
+            const RayHit hit = m_blas[inst.blas]->intersect(inst.worldInverse.applyPoint(origin),
+                                                            inst.worldInverse.applyLinear(dir), ray.tMax);
+            if (hit.valid() && hit.t <= ray.tMax)
+            {
+                ray.tMax = hit.t;
+                best = hit;
+                best.instance = static_cast<int>(primID);
+            }
+            return ray.tMax;
+        };
+        cuBQL::shrinkingRayQuery::forEachPrim(onInstance, m_tlas, ray);
+        return best;
+    }
+
+    RayHit HostSceneBVH::intersectBothWays(const float3 &origin, const float3 &dir, float maxDistance) const
+    {
+        RayHit front = intersect(origin, dir, maxDistance);
+        RayHit back = intersect(origin, make_float3(-dir.x, -dir.y, -dir.z), front.valid() ? front.t : maxDistance);
+        if (back.valid() && (!front.valid() || back.t < front.t))
+        {
+            back.t = -back.t;
+            return back;
+        }
+        return front;
+    }
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <cmath>
+#include "Object_t.h"
+
+namespace SPIN
+{
+    // Row-major 3x4 affine map p' = M p + t, laid out like Transform_t::getTRS:
+    // {m00, m01, m02, tx, m10, m11, m12, ty, m20, m21, m22, tz}.
+    struct Affine
+    {
+        float m[12] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0};
+
+        static Affine identity() { return {}; }
+
+        float3 translation() const { return make_float3(m[3], m[7], m[11]); }
+
+        // Rotation part (3x3, scale included) times v.
+        float3 applyLinear(const float3 &v) const
+        {
+            return make_float3(m[0] * v.x + m[1] * v.y + m[2] * v.z,
+                               m[4] * v.x + m[5] * v.y + m[6] * v.z,
+                               m[8] * v.x + m[9] * v.y + m[10] * v.z);
+        }
+        float3 applyPoint(const float3 &p) const { return applyLinear(p) + translation(); }
+
+        bool isIdentity() const
+        {
+            const Affine id;
+            for (int i = 0; i < 12; ++i)
+                if (m[i] != id.m[i])
+                    return false;
+            return true;
+        }
+
+        // this after b: (a * b).applyPoint(p) == a.applyPoint(b.applyPoint(p)).
+        Affine operator*(const Affine &b) const
+        {
+            Affine r;
+            for (int i = 0; i < 3; ++i)
+            {
+                for (int j = 0; j < 4; ++j)
+                {
+                    float v = m[4 * i + 0] * b.m[j] + m[4 * i + 1] * b.m[4 + j] + m[4 * i + 2] * b.m[8 + j];
+                    if (j == 3)
+                        v += m[4 * i + 3];
+                    r.m[4 * i + j] = v;
+                }
+            }
+            return r;
+        }
+
+        // Determinant of the linear part (negative for a reflection).
+        float determinant() const
+        {
+            return m[0] * (m[5] * m[10] - m[6] * m[9]) - m[1] * (m[4] * m[10] - m[6] * m[8]) +
+                   m[2] * (m[4] * m[9] - m[5] * m[8]);
+        }
+
+        // General inverse (identity when the linear part is singular).
+        Affine inverse() const
+        {
+            const float a = m[0], b = m[1], c = m[2];
+            const float d = m[4], e = m[5], f = m[6];
+            const float g = m[8], h = m[9], k = m[10];
+            const float c00 = e * k - f * h, c01 = c * h - b * k, c02 = b * f - c * e;
+            const float c10 = f * g - d * k, c11 = a * k - c * g, c12 = c * d - a * f;
+            const float c20 = d * h - e * g, c21 = b * g - a * h, c22 = a * e - b * d;
+            const float det = a * c00 + b * c10 + c * c20;
+            Affine r;
+            if (!(std::fabs(det) > 0.0f))
+                return r;
+            const float inv = 1.0f / det;
+            const float lin[9] = {c00 * inv, c01 * inv, c02 * inv, c10 * inv, c11 * inv, c12 * inv, c20 * inv, c21 * inv, c22 * inv};
+            for (int i = 0; i < 3; ++i)
+            {
+                r.m[4 * i + 0] = lin[3 * i + 0];
+                r.m[4 * i + 1] = lin[3 * i + 1];
+                r.m[4 * i + 2] = lin[3 * i + 2];
+                r.m[4 * i + 3] = -(lin[3 * i + 0] * m[3] + lin[3 * i + 1] * m[7] + lin[3 * i + 2] * m[11]);
+            }
+            return r;
+        }
+
+        // True when the linear part is a rotation (or reflection) times a uniform scale, which is returned.
+        bool similarityScale(float &scale, float tolerance = 1e-4f) const
+        {
+            const float3 c0 = make_float3(m[0], m[4], m[8]), c1 = make_float3(m[1], m[5], m[9]), c2 = make_float3(m[2], m[6], m[10]);
+            scale = length(c0);
+            const float tol = tolerance * scale;
+            return scale > 0.0f &&
+                   std::fabs(length(c1) - scale) <= tol && std::fabs(length(c2) - scale) <= tol &&
+                   std::fabs(dot(c0, c1)) <= tol * scale && std::fabs(dot(c0, c2)) <= tol * scale &&
+                   std::fabs(dot(c1, c2)) <= tol * scale;
+        }
+
+        // Rotation about the unit axis by angle (radians) followed by translation t.
+        static Affine rigid(const float3 &axis, float angle, const float3 &t)
+        {
+            const float s = std::sin(angle), c = std::cos(angle), C = 1.0f - c;
+            const float x = axis.x, y = axis.y, z = axis.z;
+            Affine r;
+            const float v[12] = {c + x * x * C, x * y * C - z * s, x * z * C + y * s, t.x,
+                                 y * x * C + z * s, c + y * y * C, y * z * C - x * s, t.y,
+                                 z * x * C - y * s, z * y * C + x * s, c + z * z * C, t.z};
+            for (int i = 0; i < 12; ++i)
+                r.m[i] = v[i];
+            return r;
+        }
+    };
+
+    // Translation * rotation * scale of a Transform_t.
+    inline Affine toAffine(const Transform_t &t)
+    {
+        Affine r;
+        t.getTRS(r.m);
+        return r;
+    }
+
+    // Decomposes into position, rotation and per-axis scale (column lengths). Shear is dropped and a
+    // reflection ends up in a negative scale.x.
+    inline Transform_t toTransform(const Affine &a)
+    {
+        Transform_t t;
+        t.position = a.translation();
+        float3 col[3] = {make_float3(a.m[0], a.m[4], a.m[8]), make_float3(a.m[1], a.m[5], a.m[9]), make_float3(a.m[2], a.m[6], a.m[10])};
+        t.scale = make_float3(length(col[0]), length(col[1]), length(col[2]));
+        if (dot(cross(col[0], col[1]), col[2]) < 0.0f)
+            t.scale.x = -t.scale.x;
+        const float s[3] = {t.scale.x, t.scale.y, t.scale.z};
+        float rom[9];
+        for (int j = 0; j < 3; ++j)
+        {
+            const float3 c = s[j] != 0.0f ? col[j] / s[j] : make_float3(j == 0, j == 1, j == 2);
+            rom[3 * j + 0] = c.x;
+            rom[3 * j + 1] = c.y;
+            rom[3 * j + 2] = c.z;
+        }
+        t.rotation = rom2quat(rom);
+        return t;
+    }
+
+    // Normals under a, given inv = a.inverse(): inverse transpose of the linear part, renormalized.
+    inline float3 transformNormal(const Affine &inv, const float3 &n)
+    {
+        const float3 r = make_float3(inv.m[0] * n.x + inv.m[4] * n.y + inv.m[8] * n.z,
+                                     inv.m[1] * n.x + inv.m[5] * n.y + inv.m[9] * n.z,
+                                     inv.m[2] * n.x + inv.m[6] * n.y + inv.m[10] * n.z);
+        const float len = length(r);
+        return len > 0.0f ? r / len : n;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "TriangleMesh.h"
+
+namespace SPIN
+{
+    struct DefectRegionOptions
+    {
+        // A vertex is out of tolerance when its value (its magnitude if absolute) exceeds threshold.
+        float threshold = 0.0f;
+        bool absolute = true;
+        // Smaller regions are dropped (their vertices get no label).
+        size_t minVertices = 1;
+        double minArea = 0.0;
+    };
+
+    // One connected set of out-of-tolerance vertices (connected through mesh edges).
+    struct DefectRegion
+    {
+        size_t vertexCount = 0;
+        // Barycentric area: a third of every triangle incident to a region vertex, per such vertex.
+        double area = 0.0;
+        float maxDeviation = 0.0f; // value of largest magnitude (or largest value when not absolute)
+        uint32_t maxVertex = 0;
+        double meanDeviation = 0.0; // area-weighted
+        float3 centroid = {0, 0, 0}; // area-weighted (vertex mean when the area is zero)
+        float3 lower = {0, 0, 0};
+        float3 upper = {0, 0, 0};
+    };
+
+    struct DefectRegions
+    {
+        static constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+
+        // Per-vertex index into regions, kNone for vertices within tolerance.
+        std::vector<uint32_t> label;
+        // Sorted by decreasing area.
+        std::vector<DefectRegion> regions;
+    };
+
+    // Connected components of the out-of-tolerance vertices of a per-vertex field (deviations, deltas
+    // between runs, ...; non-finite values never qualify). Lock-free union-find over the unique edges
+    // of the cached MeshTopology, then region statistics gathered in parallel; all passes are linear
+    // in the mesh size and the labels do not depend on the worker count.
+    DefectRegions extractDefectRegions(const TriangleMesh &mesh, const std::vector<float> &field,
+                                       const DefectRegionOptions &options = {});
+
+    // Connected components of the whole mesh through its triangles: the component of every vertex,
+    // numbered in order of the smallest vertex (kNone for vertices no triangle references), with the
+    // same union-find as extractDefectRegions.
+    std::vector<uint32_t> labelMeshComponents(const TriangleMesh &mesh, size_t &componentCount);
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include "GeometryDeviation.h"
+#include "DeviationTask.h"
+#include "HostTriangleBVH.h"
+#include "SceneBVH.h"
+
+namespace SPIN
+{
+    // Target coordinates in the source mesh frame (where the BVH lives) for DeviationOptions' transforms.
+    struct DeviationFrame
+    {
+        Affine targetToSource;
+        Affine sourceToTarget;
+        float sourceScale = 1.0f; // measured-frame length of one source unit
+        bool identity = true;
+
+        float3 point(const float3 &p) const { return identity ? p : targetToSource.applyPoint(p); }
+        // Target normal as a unit direction in the source frame.
+        float3 direction(const float3 &n) const { return identity ? n : transformNormal(sourceToTarget, n); }
+    };
+
+    // Throws std::invalid_argument when the source transform is not a similarity.
+    DeviationFrame makeDeviationFrame(const DeviationOptions &options);
+
+    // Deviations of one target against a prebuilt source BVH, parallel over the target vertices.
+    // Only the ROI selection is queried; the BVH is used as given (no culling).
+    // An optional control receives progress and is polled for cancellation between chunks.
+    DeviationResult evaluateDeviation(const HostTriangleBVH &sourceBVH, const TriangleMesh &target,
+                                      const DeviationOptions &options, DeviationControl *control = nullptr);
+
+    // Same, against every placed mesh of a scene (see HostSceneBVH); the source transform of options
+    // applies on top of the instance world matrices.
+    DeviationResult evaluateDeviation(const HostSceneBVH &sourceScene, const TriangleMesh &target,
+                                      const DeviationOptions &options, DeviationControl *control = nullptr);
+
+    // Re-queries only the listed target vertices and writes their deviations into deviations (which must
+    // cover them); returns the statistics of the new values. Nothing else of the target is touched: the ROI
+    // and time budget are not applied, and for ALONG_NORMAL without complete target normals only the listed
+    // vertices get generated normals. Used by incremental updates.
+    DeviationStats evaluateDeviationAt(const HostTriangleBVH &sourceBVH, const TriangleMesh &target,
+                                       const std::vector<uint32_t> &vertices, const DeviationOptions &options,
+                                       std::vector<float> &deviations);
+
+    // Per-triangle deviations for options.faceDeviation from the vertex deviations of the same run (faces
+    // with a NaN vertex stay NaN): the vertex mean, or for CENTROID a query at each centroid, parallel over
+    // the faces. faceDeviations is resized to the triangle count; with a face list only those are recomputed.
+    void evaluateFaceDeviations(const HostTriangleBVH &sourceBVH, const TriangleMesh &target,
+                                const std::vector<float> &vertexDeviations, const DeviationOptions &options,
+                                std::vector<float> &faceDeviations, const std::vector<uint32_t> *faces = nullptr);
+
+    // Area-weighted statistics of a per-triangle field: moments from per-worker accumulators, percentiles
+    // from a radix sort of the finite values. NaN faces are skipped; infinite ones count as misses.
+    AreaWeightedStats computeAreaWeightedStats(const TriangleMesh &target, const std::vector<float> &faceDeviations);
+
+    // Immediate approximation for coarse-to-fine runs: deviation between quadric-clustered proxies of both
+    // meshes (about proxyFraction of their triangles each), transferred to the full-resolution target
+    // vertices through their clusters. Reports exact = 0; statistics are over the transferred values.
+    DeviationResult previewDeviation(const TriangleMesh &source, const TriangleMesh &target,
+                                     const DeviationOptions &options, float proxyFraction = 0.02f);
+
+    // Acceptance limit for checkTolerance, e.g. "no more than 0.1% of the area beyond 0.5 mm".
+    struct ToleranceSpec
+    {
+        float limit = 0.0f;           // largest allowed |deviation|, in measured units
+        double maxFailFraction = 0.0; // share of the target allowed beyond the limit
+        bool areaWeighted = true;     // share of the surface area (false: of the vertices)
+        // A statistical verdict is wrong with probability at most 1 - confidence; 1 allows only
+        // deterministic verdicts (decided by the vertices actually queried).
+        double confidence = 0.999;
+        uint32_t seed = 1;
+    };
+
+    enum class ToleranceVerdict
+    {
+        PASS,
+        FAIL,
+        CANCELLED
+    };
+
+    struct ToleranceResult
+    {
+        ToleranceVerdict verdict = ToleranceVerdict::CANCELLED;
+        bool statistical = false; // decided by the confidence bound rather than by the queried vertices
+        size_t population = 0;    // target vertices under test (the ROI selection)
+        size_t queried = 0;       // distinct vertices queried
+        size_t samples = 0;       // area-proportional draws (may repeat a vertex)
+        size_t failedSamples = 0;
+        // Confidence interval of the failing share, and the shares known to fail / pass from the
+        // queried vertices alone.
+        double lowerBound = 0.0, upperBound = 1.0;
+        double knownFail = 0.0, knownPass = 0.0;
+        std::vector<uint32_t> failing; // queried vertices beyond the limit (the evidence of a FAIL)
+
+        double sampleFailFraction() const { return samples > 0 ? static_cast<double>(failedSamples) / static_cast<double>(samples) : 0.0; }
+    };
+
+    // Pass/fail check of a target against a tolerance without computing the full deviation map.
+    // Queries are bounded by the limit and drawn in rounds, one area-proportional random draw per
+    // equal-area stratum of the Morton-ordered target, so every round covers the part evenly. After
+    // each round the run stops when the queried vertices already decide the verdict, or when a
+    // sequential Chernoff bound on the failing share clears maxFailFraction at the requested
+    // confidence; an undecided run ends by querying the remaining vertices. Mode, transforms and
+    // ROI come from options (maxDistance and the statistics settings are ignored).
+    ToleranceResult checkTolerance(const HostTriangleBVH &sourceBVH, const TriangleMesh &target,
+                                   const ToleranceSpec &spec, const DeviationOptions &options = {},
+                                   DeviationControl *control = nullptr);
+
+    // One source mesh against many targets on the host: the source BVH is built once and every
+    // target is queried across the worker pool. Targets are independent; results keep their order.
+    class DeviationBatch
+    {
+    public:
+        // Fills target for the given index and returns true, or returns false when there are no more targets.
+        // Called from a background thread so the next target loads while the current one is queried.
+        using TargetLoader = std::function<bool(size_t index, TriangleMesh &target)>;
+        // Receives each result as soon as it is ready (in target order); the result may be moved out.
+        using ResultCallback = std::function<void(size_t index, const TriangleMesh &target, DeviationResult &result)>;
+
+        // An empty source gives an empty BVH; every target vertex then reports a miss.
+        explicit DeviationBatch(const TriangleMesh &source, const DeviationOptions &options = {});
+
+        void setOptions(const DeviationOptions &opts) { m_options = opts; }
+        const DeviationOptions &getOptions() const { return m_options; }
+        const HostTriangleBVH &sourceBVH() const { return m_bvh; }
+
+        // Next frame of a deforming source with the same index array: refits the BVH (see HostTriangleBVH::update).
+        // The refit is in place, so it must not overlap a run(); calling it from the ResultCallback is safe,
+        // the callback runs between targets.
+        HostTriangleBVH::UpdateKind updateSource(const TriangleMesh &deformedSource)
+        {
+            return m_bvh.update(deformedSource, m_options.refitInflationLimit);
+        }
+
+        std::vector<DeviationResult> run(const std::vector<TriangleMesh> &targets) const;
+
+        // Streams targets from the loader; returns the number of targets processed.
+        size_t run(const TargetLoader &loader, const ResultCallback &onResult) const;
+
+    private:
+        HostTriangleBVH m_bvh;
+        DeviationOptions m_options;
+    };
+}
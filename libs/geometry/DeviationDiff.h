@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "DefectRegions.h"
+#include "DeviationSidecar.h"
+
+namespace SPIN
+{
+    struct DeviationDiffOptions
+    {
+        // Compare |deviation| so a positive delta always means "further from the source".
+        bool compareMagnitude = true;
+        // Deltas beyond +-significance count as worse / better and seed the change regions.
+        float significance = 0.0f;
+        // Size filters of the change regions (see DefectRegionOptions).
+        size_t minRegionVertices = 1;
+        double minRegionArea = 0.0;
+    };
+
+    struct DeviationDiffSummary
+    {
+        size_t compared = 0;   // vertices finite in both runs
+        size_t onlyBefore = 0; // finite in one run only (e.g. a miss or ROI change)
+        size_t onlyAfter = 0;
+        size_t worse = 0, better = 0; // compared vertices beyond the significance either way
+        double meanBefore = 0.0, meanAfter = 0.0, meanDelta = 0.0;
+        double rmsBefore = 0.0, rmsAfter = 0.0, rmsDelta = 0.0;
+        float maxBefore = 0.0f, maxAfter = 0.0f;
+        float maxIncrease = 0.0f, maxDecrease = 0.0f; // largest delta and largest negative delta (as a positive number)
+    };
+
+    struct DeviationDiff
+    {
+        std::vector<float> delta; // after - before per vertex; NaN unless finite in both runs
+        DeviationDiffSummary summary;
+        DefectRegions worse;  // connected regions with delta > significance
+        DefectRegions better; // connected regions with delta < -significance (values are -delta)
+    };
+
+    // Per-vertex regression diff of two deviation fields on the same target topology. The deltas and
+    // the summary come from one parallel pass; the change regions from extractDefectRegions.
+    // Throws std::invalid_argument when a field does not have one value per target vertex.
+    DeviationDiff diffDeviations(const TriangleMesh &target, const std::vector<float> &before,
+                                 const std::vector<float> &after, const DeviationDiffOptions &options = {});
+
+    // Reads one channel of a sidecar written for target; false (with a message on std::cerr) when the
+    // file cannot be read, belongs to another topology, or lacks the channel.
+    bool loadDeviationField(const std::string &path, const TriangleMesh &target, std::vector<float> &field,
+                            const std::string &channel = "deviation");
+    // Writes a single-channel sidecar, e.g. DeviationResult::deviations for a later diff.
+    bool saveDeviationField(const std::string &path, const TriangleMesh &target, const std::vector<float> &field,
+                            const std::string &channel = "deviation");
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "DeviationBatch.h"
+#include "DeviationSidecar.h"
+
+namespace SPIN
+{
+    // Per-vertex statistics over a series of deviation results on the same target topology (repeated
+    // scans of one part, or the frames of a time series), updated one result at a time with Welford's
+    // recurrence, so memory stays at one accumulator per vertex however long the series is.
+    // Non-finite deviations (outside the ROI, misses) are left out of that vertex's statistics.
+    class DeviationSeriesAggregator
+    {
+    public:
+        explicit DeviationSeriesAggregator(size_t vertexCount = 0) { reset(vertexCount); }
+
+        void reset(size_t vertexCount);
+
+        // Throws std::invalid_argument when the result does not have one value per vertex.
+        void add(const std::vector<float> &deviations);
+        void add(const DeviationResult &result) { add(result.deviations); }
+
+        // Plugs into DeviationBatch::run(loader, callback): every streamed result is folded in as it arrives.
+        DeviationBatch::ResultCallback callback()
+        {
+            return [this](size_t, const TriangleMesh &, DeviationResult &result) { add(result); };
+        }
+
+        size_t vertexCount() const { return m_count.size(); }
+        size_t seriesLength() const { return m_series; }
+
+        // Per-vertex fields; count() is 0 and the other fields NaN for vertices without a finite value.
+        std::vector<float> count() const;
+        std::vector<float> mean() const;
+        std::vector<float> stddev() const; // sample standard deviation (0 for a single value)
+        std::vector<float> min() const;
+        std::vector<float> max() const;
+
+        // Sidecar with the channels "count", "mean", "stddev", "min" and "max" for the given target.
+        DeviationSidecar toSidecar(const TriangleMesh &target) const;
+        bool write(const std::string &path, const TriangleMesh &target) const
+        {
+            return writeDeviationSidecar(path, toSidecar(target));
+        }
+
+    private:
+        template <typename F>
+        std::vector<float> field(F &&value) const;
+
+        size_t m_series = 0;
+        std::vector<uint32_t> m_count;
+        std::vector<double> m_mean;
+        std::vector<double> m_m2;
+        std::vector<float> m_min;
+        std::vector<float> m_max;
+    };
+}
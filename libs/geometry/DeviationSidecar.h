@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "TriangleMesh.h"
+
+namespace SPIN
+{
+    // Named per-vertex float channels stored next to a target mesh ("deviation", "mean", "stddev", ...).
+    // The counts and topology hash tie the file to the target it was computed on.
+    struct DeviationSidecar
+    {
+        uint64_t vertexCount = 0;
+        uint64_t triangleCount = 0;
+        uint64_t topologyHash = 0;
+        std::vector<std::string> names;
+        std::vector<std::vector<float>> channels;
+
+        DeviationSidecar() = default;
+        explicit DeviationSidecar(const TriangleMesh &target);
+
+        // Adds or replaces a channel; its size must be vertexCount.
+        void set(const std::string &name, std::vector<float> values);
+        // nullptr when there is no such channel.
+        const std::vector<float> *find(const std::string &name) const;
+
+        bool matches(const TriangleMesh &target) const;
+    };
+
+    // FNV-1a over the index array (vertex positions are not part of it): fixed-size chunks are hashed
+    // in parallel and their hashes combined in order with another FNV-1a pass.
+    uint64_t meshTopologyHash(const TriangleMesh &mesh);
+
+    // Binary little-endian layout: "SPINDEV1", vertex count, triangle count, topology hash (uint64 each),
+    // channel count (uint32), per channel a uint32 name length and the name, then every channel's floats.
+    // Both return false (with a message on std::cerr) on I/O or format errors.
+    bool writeDeviationSidecar(const std::string &path, const DeviationSidecar &sidecar);
+    bool readDeviationSidecar(const std::string &path, DeviationSidecar &sidecar);
+}
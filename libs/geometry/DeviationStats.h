@@ -0,0 +1,288 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+#include "QuantileSketch.h"
+
+namespace SPIN
+{
+    // Area-weighted statistics of a per-triangle deviation field, independent of the tessellation density.
+    // Faces are added with their area as weight; percentiles are filled from a sorted pass at the end.
+    struct AreaWeightedStats
+    {
+        uint64_t faceCount = 0;
+        uint64_t missFaceCount = 0; // non-finite face values (misses)
+        double area = 0.0;          // of the counted faces
+        double missArea = 0.0;
+        float min = std::numeric_limits<float>::infinity();
+        float max = -std::numeric_limits<float>::infinity();
+        double mean = 0.0;
+        double m2 = 0.0;         // weighted sum of squared differences from the mean (West)
+        double sumSquares = 0.0; // area-weighted
+        // Area-weighted order statistics at 1% steps: percentiles[k] is the k-th percentile (0 until filled).
+        std::array<float, 101> percentiles{};
+
+        // Incremental updates: area of the faces changed since the percentile table was built (kept by
+        // the owner), and whether subtract() may have removed the min or max. The owner rebuilds.
+        double staleArea = 0.0;
+        bool extremaStale = false;
+
+        void add(float d, double w)
+        {
+            if (!std::isfinite(d))
+            {
+                ++missFaceCount;
+                missArea += w;
+                return;
+            }
+            ++faceCount;
+            min = std::min(min, d);
+            max = std::max(max, d);
+            if (!(w > 0.0))
+                return;
+            area += w;
+            const double delta = d - mean;
+            mean += delta * w / area;
+            m2 += w * delta * (d - mean);
+            sumSquares += w * double(d) * double(d);
+        }
+
+        void merge(const AreaWeightedStats &o)
+        {
+            missFaceCount += o.missFaceCount;
+            missArea += o.missArea;
+            faceCount += o.faceCount;
+            min = std::min(min, o.min);
+            max = std::max(max, o.max);
+            if (!(o.area > 0.0))
+                return;
+            const double total = area + o.area;
+            const double delta = o.mean - mean;
+            mean += delta * o.area / total;
+            m2 += o.m2 + delta * delta * area * o.area / total;
+            sumSquares += o.sumSquares;
+            area = total;
+        }
+
+        // Inverse of merge for faces added earlier; moments stay exact, min/max are only flagged.
+        void subtract(const AreaWeightedStats &o)
+        {
+            missFaceCount -= std::min(missFaceCount, o.missFaceCount);
+            missArea = std::max(0.0, missArea - o.missArea);
+            faceCount -= std::min(faceCount, o.faceCount);
+            if (o.faceCount > 0 && (o.min <= min || o.max >= max))
+                extremaStale = true;
+            if (!(o.area > 0.0))
+                return;
+            const double rest = area - o.area;
+            if (!(rest > 0.0))
+            {
+                area = mean = m2 = sumSquares = 0.0;
+                return;
+            }
+            const double restMean = (area * mean - o.area * o.mean) / rest;
+            const double delta = o.mean - restMean;
+            m2 = std::max(0.0, m2 - o.m2 - delta * delta * rest * o.area / area);
+            mean = restMean;
+            sumSquares = std::max(0.0, sumSquares - o.sumSquares);
+            area = rest;
+        }
+
+        double variance() const { return area > 0.0 ? m2 / area : 0.0; }
+        double stddev() const { return std::sqrt(variance()); }
+        double rms() const { return area > 0.0 ? std::sqrt(sumSquares / area) : 0.0; }
+        // p in [0, 100], linearly interpolated between the 1% table entries.
+        float percentile(double p) const
+        {
+            const double x = std::clamp(p, 0.0, 100.0);
+            const size_t i = std::min<size_t>(99, static_cast<size_t>(x));
+            const float t = static_cast<float>(x - static_cast<double>(i));
+            return percentiles[i] + (percentiles[i + 1] - percentiles[i]) * t;
+        }
+    };
+
+    // Streaming deviation statistics; one instance per worker, merged at the end.
+    // Non-finite values (misses beyond maxDistance) are only counted in missCount.
+    struct DeviationStats
+    {
+        uint64_t count = 0;
+        uint64_t missCount = 0;
+        float min = std::numeric_limits<float>::infinity();
+        float max = -std::numeric_limits<float>::infinity();
+        double mean = 0.0;
+        double m2 = 0.0; // sum of squared differences from the mean (Welford)
+        double sumSquares = 0.0;
+
+        // Fixed-bin histogram over [histogramMin, histogramMax]; out-of-range values land in the end bins.
+        float histogramMin = 0.0f;
+        float histogramMax = 1.0f;
+        std::vector<uint64_t> histogram;
+
+        // Percentiles (bounded rank error, or exact when requested).
+        QuantileSketch quantiles;
+
+        // Set by subtract(): values removed from the moments but still held by the sketch, and whether
+        // a removed value may have been the min or max. The owner rescans when these matter.
+        uint64_t staleQuantileCount = 0;
+        bool extremaStale = false;
+
+        // Per-triangle, area-weighted counterpart (DeviationOptions::faceDeviation). Filled over the whole
+        // mesh after a pass (see computeAreaWeightedStats) and updated face by face on incremental reruns;
+        // add/merge/subtract of DeviationStats leave it alone.
+        AreaWeightedStats area;
+
+        DeviationStats() = default;
+        DeviationStats(float hMin, float hMax, int bins, int sketchK = 200, bool exactQuantiles = false)
+        {
+            reset(hMin, hMax, bins, sketchK, exactQuantiles);
+        }
+
+        void reset(float hMin, float hMax, int bins, int sketchK = 200, bool exactQuantiles = false)
+        {
+            *this = DeviationStats();
+            histogramMin = hMin;
+            histogramMax = (hMax > hMin) ? hMax : hMin + 1.0f;
+            histogram.assign(static_cast<size_t>(std::max(1, bins)), 0);
+            quantiles = QuantileSketch(sketchK, exactQuantiles);
+        }
+
+        void add(float d)
+        {
+            if (!std::isfinite(d))
+            {
+                ++missCount;
+                return;
+            }
+            ++count;
+            min = std::min(min, d);
+            max = std::max(max, d);
+            const double delta = d - mean;
+            mean += delta / static_cast<double>(count);
+            m2 += delta * (d - mean);
+            sumSquares += double(d) * double(d);
+            if (!histogram.empty())
+                ++histogram[binIndex(d)];
+            quantiles.add(d);
+        }
+
+        // Chan et al. parallel combination; both sides must share the histogram layout.
+        void merge(const DeviationStats &o)
+        {
+            missCount += o.missCount;
+            staleQuantileCount += o.staleQuantileCount;
+            extremaStale = extremaStale || o.extremaStale;
+            if (o.count == 0)
+                return;
+            const double n = static_cast<double>(count + o.count);
+            const double delta = o.mean - mean;
+            mean += delta * static_cast<double>(o.count) / n;
+            m2 += o.m2 + delta * delta * static_cast<double>(count) * static_cast<double>(o.count) / n;
+            count += o.count;
+            min = std::min(min, o.min);
+            max = std::max(max, o.max);
+            sumSquares += o.sumSquares;
+            if (histogram.size() == o.histogram.size())
+                for (size_t i = 0; i < histogram.size(); ++i)
+                    histogram[i] += o.histogram[i];
+            quantiles.merge(o.quantiles);
+        }
+
+        // Inverse of merge for values added earlier (incremental updates). Moments, sums and the histogram
+        // stay exact; the sketch cannot delete, so the removed values are only counted as stale.
+        void subtract(const DeviationStats &o)
+        {
+            missCount -= std::min(missCount, o.missCount);
+            if (o.count == 0)
+                return;
+            staleQuantileCount += o.count;
+            if (histogram.size() == o.histogram.size())
+                for (size_t i = 0; i < histogram.size(); ++i)
+                    histogram[i] -= std::min(histogram[i], o.histogram[i]);
+            if (o.count >= count)
+            {
+                count = 0;
+                mean = m2 = sumSquares = 0.0;
+                min = std::numeric_limits<float>::infinity();
+                max = -std::numeric_limits<float>::infinity();
+                return;
+            }
+            const double n = static_cast<double>(count);
+            const double nB = static_cast<double>(o.count);
+            const double nA = n - nB;
+            const double meanA = (n * mean - nB * o.mean) / nA;
+            const double delta = o.mean - meanA;
+            m2 = std::max(0.0, m2 - o.m2 - delta * delta * nA * nB / n);
+            mean = meanA;
+            count -= o.count;
+            sumSquares = std::max(0.0, sumSquares - o.sumSquares);
+            if (o.min <= min || o.max >= max)
+                extremaStale = true;
+        }
+
+        double variance() const { return count > 1 ? m2 / static_cast<double>(count - 1) : 0.0; }
+        double stddev() const { return std::sqrt(variance()); }
+        double rms() const { return count > 0 ? std::sqrt(sumSquares / static_cast<double>(count)) : 0.0; }
+        // p in [0, 100], e.g. percentile(95).
+        float percentile(double p) const { return quantiles.quantile(p / 100.0); }
+
+        size_t binIndex(float d) const
+        {
+            const float t = (d - histogramMin) / (histogramMax - histogramMin);
+            const long bin = static_cast<long>(t * static_cast<float>(histogram.size()));
+            return static_cast<size_t>(std::clamp<long>(bin, 0, static_cast<long>(histogram.size()) - 1));
+        }
+        float binLower(size_t bin) const
+        {
+            return histogramMin + (histogramMax - histogramMin) * static_cast<float>(bin) / static_cast<float>(histogram.size());
+        }
+    };
+
+    // Per-worker statistics of numbered groups (materials, components, ...), created when a worker first
+    // adds to a group, so memory follows the groups each worker touches. Consecutive values mostly share
+    // a group; the last one is cached.
+    class DeviationGroupStats
+    {
+    public:
+        DeviationGroupStats(size_t groups, const DeviationStats &layout, unsigned workers)
+            : m_groups(groups), m_layout(layout), m_workers(std::max(1u, workers))
+        {
+        }
+
+        void add(unsigned worker, uint32_t group, float d)
+        {
+            Worker &w = m_workers[worker];
+            if (group != w.lastGroup)
+            {
+                w.last = &w.stats.try_emplace(group, m_layout).first->second;
+                w.lastGroup = group;
+            }
+            w.last->add(d);
+        }
+
+        // Statistics of every group (empty layout for untouched ones), merged in worker order.
+        std::vector<DeviationStats> merge() const
+        {
+            std::vector<DeviationStats> out(m_groups, m_layout);
+            for (const Worker &w : m_workers)
+                for (const auto &entry : w.stats)
+                    out[entry.first].merge(entry.second);
+            return out;
+        }
+
+    private:
+        struct Worker
+        {
+            std::unordered_map<uint32_t, DeviationStats> stats; // node-based: the cached pointer stays valid
+            uint32_t lastGroup = std::numeric_limits<uint32_t>::max();
+            DeviationStats *last = nullptr;
+        };
+
+        size_t m_groups;
+        DeviationStats m_layout;
+        std::vector<Worker> m_workers;
+    };
+}
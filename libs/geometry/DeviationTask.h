@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+
+namespace SPIN
+{
+    enum class TaskStatus
+    {
+        RUNNING,
+        COMPLETED,
+        CANCELLED, // stopped at a chunk boundary; unprocessed vertices are NaN
+        FAILED     // the computation threw; wait() rethrows the exception
+    };
+
+    // Shared between a running computation and its handles.
+    // The computation adds finished vertices to done and polls cancelRequested between chunks.
+    struct DeviationControl
+    {
+        std::atomic<uint64_t> done{0};
+        std::atomic<uint64_t> total{0};
+        std::atomic<bool> cancelRequested{false};
+
+        bool cancelled() const { return cancelRequested.load(std::memory_order_relaxed); }
+        void advance(uint64_t n) { done.fetch_add(n, std::memory_order_relaxed); }
+    };
+
+    // Handle to an asynchronous deviation run; copies share the same run.
+    class DeviationTask
+    {
+    public:
+        DeviationTask() = default;
+        DeviationTask(std::shared_ptr<DeviationControl> control, std::shared_future<TaskStatus> future)
+            : m_control(std::move(control)), m_future(std::move(future))
+        {
+        }
+
+        bool valid() const { return m_future.valid(); }
+        bool ready() const
+        {
+            return valid() && m_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }
+
+        // Blocks until the run ends; rethrows the exception of a failed run.
+        TaskStatus wait() const { return m_future.get(); }
+
+        TaskStatus status() const
+        {
+            if (!ready())
+                return TaskStatus::RUNNING;
+            try
+            {
+                return m_future.get();
+            }
+            catch (...)
+            {
+                return TaskStatus::FAILED;
+            }
+        }
+
+        // Cooperative: the run stops at the next chunk boundary.
+        void cancel() const
+        {
+            if (m_control)
+                m_control->cancelRequested.store(true, std::memory_order_relaxed);
+        }
+
+        uint64_t done() const { return m_control ? m_control->done.load(std::memory_order_relaxed) : 0; }
+        uint64_t total() const { return m_control ? m_control->total.load(std::memory_order_relaxed) : 0; }
+        // Fraction of queried vertices in [0, 1] (0 until the query pass has started).
+        float progress() const
+        {
+            const uint64_t t = total();
+            return t > 0 ? static_cast<float>(static_cast<double>(done()) / static_cast<double>(t)) : 0.0f;
+        }
+
+    private:
+        std::shared_ptr<DeviationControl> m_control;
+        std::shared_future<TaskStatus> m_future;
+    };
+}
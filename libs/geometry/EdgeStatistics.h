@@ -0,0 +1,34 @@
+#pragma once
+#include <array>
+#include <memory>
+#include "TriangleMesh.h"
+
+namespace SPIN
+{
+    struct MeshTopology;
+
+    // Length statistics over the unique (undirected) edges of a mesh.
+    struct EdgeLengthStats
+    {
+        size_t count = 0;
+        float min = 0.0f;
+        float max = 0.0f;
+        float mean = 0.0f;
+        float median = 0.0f;
+        // Exact order statistics at 1% steps: percentiles[k] is the k-th percentile.
+        std::array<float, 101> percentiles{};
+
+        // Topology the statistics were computed from (cache validation).
+        std::shared_ptr<const MeshTopology> topology;
+
+        // Percentile in [0, 100], linearly interpolated between the 1% table entries.
+        float percentile(float p) const;
+    };
+
+    // One parallel pass over the unique edges plus selection (no full sort).
+    std::shared_ptr<const EdgeLengthStats> computeEdgeLengthStats(const TriangleMesh &mesh);
+
+    // Returns the statistics cached on the mesh, computing them on first use.
+    // Call mesh.invalidateCaches() after moving vertices in place.
+    std::shared_ptr<const EdgeLengthStats> meshEdgeStats(const TriangleMesh &mesh);
+}
@@ -1,17 +1,129 @@
 #pragma once
 #include <algorithm>
 #include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <vector>
 #include "TriangleMesh.h"
+#include "Affine.h"
+#include "DeviationStats.h"
+#include "RegionOfInterest.h"
+#include "DeviationTask.h"
+#include "Registration.h"
 
 namespace SPIN
 {
+    class HostTriangleBVH;
+
     enum class ExecTag
     {
         HOST,
         DEVICE
     };
 
+    enum class DeviationMode
+    {
+        CLOSEST_POINT, // unsigned distance to the closest source point
+        ALONG_NORMAL   // distance along +/- the target vertex normal (host only)
+    };
+
+    enum class FaceDeviationMode
+    {
+        NONE,
+        VERTEX_MEAN, // mean of the three vertex deviations
+        CENTROID     // a query at the triangle centroid (along the face normal for ALONG_NORMAL; host only)
+    };
+
+    struct DeviationOptions
+    {
+        DeviationMode mode = DeviationMode::CLOSEST_POINT;
+        // Cutoff for queries and rays; vertices with nothing closer report INFINITY.
+        float maxDistance = INFINITY;
+        // ALONG_NORMAL: use the closest-point distance for vertices whose rays miss.
+        bool closestPointFallback = true;
+        // ALONG_NORMAL: negative when the hit (or the closest-point fallback) lies against the normal direction.
+        bool signedDistance = false;
+        // Histogram layout of DeviationStats; range 0 = maxDistance if finite, else the source diagonal.
+        int histogramBins = 64;
+        float histogramRange = 0.0f;
+        // Percentile sketch accuracy (larger k = smaller rank error); exact mode keeps every value.
+        int quantileSketchK = 200;
+        bool exactQuantiles = false;
+        // Host only: deviations outside the ROI are NaN and left out of the statistics.
+        RegionOfInterest roi;
+        // Host only: > 0 stops querying once this many milliseconds have passed since the run started.
+        // Vertices are visited in a stratified Morton order and the rest take the deviation of their
+        // nearest computed neighbour along the curve (excluded from the statistics).
+        float timeBudgetMs = 0.0f;
+        // Host only: a deformed source is refitted until its BVH cost grows past this factor (see updateSource).
+        float refitInflationLimit = 1.5f;
+        // Host only: placement of each mesh in the frame where deviations are measured. Query points and
+        // normals are mapped on the fly; the meshes are never copied. The source transform must be rigid
+        // up to a uniform scale. ROI boxes stay in target mesh coordinates.
+        Affine targetTransform;
+        Affine sourceTransform;
+        // Per-triangle deviations and area-weighted statistics (DeviationStats::area) next to the vertex
+        // ones. The device path supports VERTEX_MEAN only.
+        FaceDeviationMode faceDeviation = FaceDeviationMode::NONE;
+        // Statistics per source material of the hit triangle and per target connected component, gathered
+        // in the query pass (DeviationResult::breakdown). The device path supports the components only.
+        bool breakdownByMaterial = false;
+        bool breakdownByComponent = false;
+        // Material of every source triangle for single-mesh sources (e.g. from mergeScene); without it all
+        // hits take the source mesh's own TriangleMesh::materialID. Scene sources use the materialID of
+        // the hit instance's mesh instead.
+        std::shared_ptr<const std::vector<int>> sourceTriangleMaterials;
+    };
+
+    // Empty statistics with the histogram layout implied by the options.
+    inline DeviationStats makeDeviationStats(const DeviationOptions &options, float sourceDiagonal)
+    {
+        float range = options.histogramRange;
+        if (range <= 0.0f)
+            range = std::isfinite(options.maxDistance) ? options.maxDistance : sourceDiagonal;
+        const bool isSigned = options.mode == DeviationMode::ALONG_NORMAL && options.signedDistance;
+        return DeviationStats(isSigned ? -range : 0.0f, range, options.histogramBins,
+                              options.quantileSketchK, options.exactQuantiles);
+    }
+
+    // Per-group statistics of one run; every group has the histogram layout of the run's statistics,
+    // except that component statistics carry no histogram (a scan can have many small components).
+    struct DeviationBreakdown
+    {
+        static constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+
+        // Source materials in ascending order, and the statistics of the vertices whose deviation came
+        // from a triangle of each. Vertices without a hit are only counted in the overall statistics.
+        std::vector<int> materials;
+        std::vector<DeviationStats> byMaterial;
+        // Connected component of every target vertex (kNone for vertices outside every triangle), numbered
+        // in order of the smallest vertex, and the statistics of each component.
+        std::vector<uint32_t> componentLabel;
+        std::vector<DeviationStats> byComponent;
+
+        // Index into materials, or -1 when the material is not in the source.
+        int materialIndex(int material) const
+        {
+            const auto it = std::lower_bound(materials.begin(), materials.end(), material);
+            return it != materials.end() && *it == material ? static_cast<int>(it - materials.begin()) : -1;
+        }
+    };
+
+    // Per-target output of a host deviation pass.
+    struct DeviationResult
+    {
+        std::vector<float> deviations; // one per target vertex; NaN outside the ROI
+        std::vector<float> faceDeviations; // one per target triangle with options.faceDeviation; NaN when a vertex is outside the run
+        DeviationStats stats;
+        DeviationBreakdown breakdown; // with options.breakdownByMaterial / breakdownByComponent
+        bool cancelled = false; // some vertices were skipped after a cancel request (left NaN)
+        size_t queried = 0;     // target vertices in the run (the ROI selection)
+        size_t exact = 0;       // of those, vertices actually queried (the rest interpolated or skipped)
+
+        double exactFraction() const { return queried > 0 ? static_cast<double>(exact) / static_cast<double>(queried) : 1.0; }
+    };
+
     class ColorMapLibrary{
     public:
         static std::vector<float3> JetColorMap(int divCount = 256){
@@ -107,9 +219,14 @@ class GeometryDeviationBase
 {
 protected:
     mutable std::vector<float> deviations;
+    mutable std::vector<float> faceDeviations;
+    mutable SPIN::DeviationStats stats;
+    mutable SPIN::DeviationBreakdown breakdown;
+    mutable double exactFraction = 1.0;
     TriangleMesh sourceMesh;
     TriangleMesh targetMesh;
     bool uSampling = false;
+    SPIN::DeviationOptions options;
 
 public:
     GeometryDeviationBase(const TriangleMesh &source, const TriangleMesh &target, bool useSampling = false)
@@ -127,6 +244,10 @@ public:
             make_float3(1, 0, 0)};
         const auto &map = colorMap.empty() ? kDefaultMap : colorMap;
 
+        // Vertices that were not evaluated (outside the ROI) get the lowest color
+        if (std::isnan(d))
+            return map.front();
+
         // Clamp normalized deviation
         float nd = std::clamp(d, 0.0f, 1.0f);
 
@@ -167,9 +288,28 @@ public:
             c0.y + (c1.y - c0.y) * localT,
             c0.z + (c1.z - c0.z) * localT);
     }
+    void setOptions(const SPIN::DeviationOptions &opts) { options = opts; }
+    const SPIN::DeviationOptions &getOptions() const { return options; }
+
     virtual void computeDeviation() const = 0;
     void setDeviation(const std::vector<float> &dev) const { deviations = dev; }
     virtual const std::vector<float> &getDeviations() const = 0;
+
+    // Per-triangle deviations of the last run when options.faceDeviation is set (empty otherwise).
+    const std::vector<float> &getFaceDeviations() const { return faceDeviations; }
+
+    // Statistics gathered during the last computeDeviation() (stats.area with options.faceDeviation).
+    const SPIN::DeviationStats &getStats() const { return stats; }
+    // Per-material / per-component statistics of the last run when the options request them.
+    const SPIN::DeviationBreakdown &getBreakdown() const { return breakdown; }
+    // Fraction of the evaluated vertices that were queried exactly (below 1 after a time-budgeted run).
+    double getExactFraction() const { return exactFraction; }
+
+protected:
+    SPIN::DeviationStats emptyStats(float sourceDiagonal) const
+    {
+        return SPIN::makeDeviationStats(options, sourceDiagonal);
+    }
 };
 
 template <SPIN::ExecTag ExecTag>
@@ -183,6 +323,60 @@ public:
 
     void computeDeviation() const override;
     const std::vector<float> &getDeviations() const override;
+
+    // Runs computeDeviation on a background thread. Deviations and stats are stored when the run
+    // ends (partial, with NaN for skipped vertices, when cancelled); read them only once the task is ready.
+    // onComplete is called on the background thread after the results are stored.
+    // This object must outlive the task. Until the run has stored its results, the object (source BVH,
+    // meshes, results) belongs to it: updateSource, updateDeviation, alignTarget and another
+    // computeDeviationAsync block until then (called from onComplete they proceed at once), and no
+    // other member may be called concurrently.
+    SPIN::DeviationTask computeDeviationAsync(std::function<void(SPIN::TaskStatus)> onComplete = {}) const;
+
+    // Coarse-to-fine: fills preview from simplified proxies (see SPIN::previewDeviation) before returning,
+    // then starts the exact run in the background like computeDeviationAsync.
+    SPIN::DeviationTask computeDeviationProgressive(SPIN::DeviationResult &preview, float proxyFraction = 0.02f,
+                                                    std::function<void(SPIN::TaskStatus)> onComplete = {}) const;
+
+    // Incremental rerun after editing the target: re-queries only the vertices in editedTarget.dirtyRanges
+    // (plus appended vertices, and their one-ring for ALONG_NORMAL) against the cached source BVH and
+    // updates the statistics in place. Clears editedTarget's dirty ranges. Only the dirty positions are
+    // copied into the cached target; its index is copied (and the topology shared with editedTarget) only
+    // when the connectivity changed, so repeated edits cost O(edited vertices) after the first update.
+    // Area-weighted statistics follow the touched faces; their percentile table is rebuilt once the
+    // changed area exceeds 1% of the total.
+    // Falls back to computeDeviation without a complete exact previous run, when vertices were removed
+    // or when a breakdown is requested.
+    void updateDeviation(TriangleMesh &editedTarget);
+
+    // Replaces the source with a deformed copy that keeps the same index array. The cached source BVH
+    // is refitted (or rebuilt once refits have degraded it, see HostTriangleBVH::update) instead of
+    // being rebuilt by the next computeDeviation. A different index array just replaces the source.
+    // Waits for an asynchronous run first, since the refit happens in place.
+    void updateSource(const TriangleMesh &deformedSource);
+
+    // Rigidly aligns the target to the source with point-to-plane ICP against the cached full source BVH,
+    // starting from the current options' targetTransform (e.g. a coarse registration), and stores the
+    // aligned pose there so the next run measures it. The target mesh itself is not modified.
+    SPIN::IcpResult alignTarget(const SPIN::IcpOptions &icp = {});
+
+private:
+    // The cached source BVH, rebuilt when missing or culled to an ROI.
+    const SPIN::HostTriangleBVH &fullSourceBVH() const;
+
+    bool run(SPIN::DeviationControl *control) const;
+    void refreshStaleStats() const;
+    void refreshStaleAreaStats() const;
+    // Blocks until the last asynchronous run no longer uses this object.
+    void waitForAsyncRun() const;
+
+    // Source BVH of the last run, reused by updateDeviation (culled = built over an ROI subset).
+    mutable std::shared_ptr<SPIN::HostTriangleBVH> sourceBVH;
+    mutable bool sourceBVHCulled = false;
+    mutable bool lastRunComplete = false;
+    // Last asynchronous run, and whether it may still touch this object (cleared before onComplete).
+    mutable std::shared_future<SPIN::TaskStatus> asyncRun;
+    mutable std::shared_ptr<std::atomic<bool>> asyncBusy;
 };
 
 template <>
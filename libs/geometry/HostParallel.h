@@ -0,0 +1,152 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SPIN
+{
+    // Number of workers used by the host engine (hardware threads, at least one).
+    inline unsigned hostWorkerCount()
+    {
+        static const unsigned count = std::max(1u, std::thread::hardware_concurrency());
+        return count;
+    }
+
+    // Dynamically scheduled parallel loop over [begin, end).
+    // body(chunkBegin, chunkEnd, workerIdx) is called once per chunk of at most `grain` items.
+    // workerIdx is in [0, hostWorkerCount()) and can index per-worker accumulators.
+    // The first exception thrown by a chunk is rethrown on the calling thread.
+    template <typename Body>
+    void parallelFor(size_t begin, size_t end, size_t grain, Body &&body)
+    {
+        if (begin >= end)
+            return;
+        grain = std::max<size_t>(1, grain);
+
+        const size_t chunks = (end - begin + grain - 1) / grain;
+        const unsigned workers = static_cast<unsigned>(std::min<size_t>(hostWorkerCount(), chunks));
+        if (workers <= 1)
+        {
+            for (size_t b = begin; b < end; b += grain)
+                body(b, std::min(b + grain, end), 0u);
+            return;
+        }
+
+        std::atomic<size_t> next{begin};
+        std::exception_ptr error;
+        std::mutex errorMutex;
+
+        auto worker = [&](unsigned workerIdx) {
+            try
+            {
+                for (;;)
+                {
+                    const size_t b = next.fetch_add(grain, std::memory_order_relaxed);
+                    if (b >= end)
+                        break;
+                    body(b, std::min(b + grain, end), workerIdx);
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error)
+                    error = std::current_exception();
+                next.store(end, std::memory_order_relaxed);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(workers - 1);
+        for (unsigned w = 1; w < workers; ++w)
+            threads.emplace_back(worker, w);
+        worker(0);
+        for (auto &t : threads)
+            t.join();
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    // Stable parallel LSD radix sort of the low `keyBits` bits of each key (8-bit digits).
+    inline void parallelRadixSort(std::vector<uint64_t> &keys, unsigned keyBits = 64)
+    {
+        const size_t n = keys.size();
+        if (n < 2)
+            return;
+
+        constexpr unsigned kDigitBits = 8;
+        constexpr size_t kBuckets = size_t(1) << kDigitBits;
+        const size_t blocks = std::min<size_t>(hostWorkerCount() * 4, std::max<size_t>(1, n / 4096));
+        const size_t blockSize = (n + blocks - 1) / blocks;
+
+        std::vector<uint64_t> scratch(n);
+        std::vector<size_t> offsets(blocks * kBuckets);
+
+        for (unsigned shift = 0; shift < keyBits; shift += kDigitBits)
+        {
+            std::fill(offsets.begin(), offsets.end(), 0);
+            parallelFor(0, n, blockSize, [&](size_t b, size_t e, unsigned) {
+                size_t *hist = &offsets[(b / blockSize) * kBuckets];
+                for (size_t i = b; i < e; ++i)
+                    ++hist[(keys[i] >> shift) & (kBuckets - 1)];
+            });
+
+            // Digit-major, block-minor exclusive scan keeps the sort stable.
+            size_t running = 0;
+            bool singleBucket = false;
+            for (size_t d = 0; d < kBuckets; ++d)
+            {
+                size_t digitTotal = 0;
+                for (size_t blk = 0; blk < blocks; ++blk)
+                {
+                    const size_t count = offsets[blk * kBuckets + d];
+                    offsets[blk * kBuckets + d] = running;
+                    running += count;
+                    digitTotal += count;
+                }
+                singleBucket |= (digitTotal == n);
+            }
+            if (singleBucket)
+                continue;
+
+            parallelFor(0, n, blockSize, [&](size_t b, size_t e, unsigned) {
+                size_t *cursor = &offsets[(b / blockSize) * kBuckets];
+                for (size_t i = b; i < e; ++i)
+                    scratch[cursor[(keys[i] >> shift) & (kBuckets - 1)]++] = keys[i];
+            });
+            keys.swap(scratch);
+        }
+    }
+
+    // Indices i in [0, n) with pred(i) true, in ascending order (parallel count, scan, fill).
+    template <typename Pred>
+    std::vector<uint32_t> parallelSelect(size_t n, Pred &&pred)
+    {
+        const size_t blockSize = std::max<size_t>(16384, (n + hostWorkerCount() - 1) / hostWorkerCount());
+        const size_t blocks = (n + blockSize - 1) / blockSize;
+        std::vector<size_t> blockStart(blocks + 1, 0);
+        parallelFor(0, n, blockSize, [&](size_t b, size_t e, unsigned) {
+            size_t count = 0;
+            for (size_t i = b; i < e; ++i)
+                count += pred(i) ? 1 : 0;
+            blockStart[b / blockSize + 1] = count;
+        });
+        for (size_t blk = 0; blk < blocks; ++blk)
+            blockStart[blk + 1] += blockStart[blk];
+
+        std::vector<uint32_t> selected(blockStart[blocks]);
+        parallelFor(0, n, blockSize, [&](size_t b, size_t e, unsigned) {
+            size_t out = blockStart[b / blockSize];
+            for (size_t i = b; i < e; ++i)
+                if (pred(i))
+                    selected[out++] = static_cast<uint32_t>(i);
+        });
+        return selected;
+    }
+}
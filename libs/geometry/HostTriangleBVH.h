@@ -0,0 +1,104 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include "TriangleMesh.h"
+
+#include "cuBQL/bvh.h"
+#include "cuBQL/queries/triangleData/closestPointOnAnyTriangle.h"
+
+namespace SPIN
+{
+    struct ClosestHit
+    {
+        float distance = INFINITY;
+        int triangle = -1;
+        float3 point = {0, 0, 0};
+        int instance = -1; // scene queries (see HostSceneBVH); triangle is then local to the instance's mesh
+
+        bool valid() const { return triangle >= 0; }
+    };
+
+    struct RayHit
+    {
+        // Signed ray parameter; |t| is the distance for unit-length directions.
+        float t = INFINITY;
+        int triangle = -1;
+        int instance = -1;
+
+        bool valid() const { return triangle >= 0; }
+    };
+
+    // cuBQL triangle BVH over a source mesh, built and queried on the host.
+    // Built once and shared by every host-side analysis that needs source queries.
+    class HostTriangleBVH
+    {
+    public:
+        HostTriangleBVH() = default;
+        explicit HostTriangleBVH(const TriangleMesh &mesh) { build(mesh); }
+        ~HostTriangleBVH() { release(); }
+
+        HostTriangleBVH(const HostTriangleBVH &) = delete;
+        HostTriangleBVH &operator=(const HostTriangleBVH &) = delete;
+
+        void build(const TriangleMesh &mesh);
+        // Builds over a subset of mesh.index; hits still report the original triangle index.
+        void build(const TriangleMesh &mesh, const std::vector<uint32_t> &triangleSubset);
+        void release();
+
+        // Moves the triangles to the vertex positions of mesh, which must keep the index array of the
+        // build, and refits the node bounds bottom-up (parallel per tree level). The topology of the
+        // tree is kept. Returns false when nothing is built or the triangle count differs.
+        bool refit(const TriangleMesh &mesh);
+
+        enum class UpdateKind
+        {
+            REFIT,
+            REBUILD
+        };
+        // Refit, falling back to a full rebuild when the refitted tree's surface-area cost exceeds
+        // inflationLimit times the cost right after the last build (or when refit is not possible).
+        UpdateKind update(const TriangleMesh &mesh, float inflationLimit = 1.5f);
+
+        // SAH-style traversal cost relative to the root box (grows as refits inflate the nodes).
+        float surfaceAreaCost() const;
+
+        bool empty() const { return m_triangles.empty(); }
+        size_t triangleCount() const { return m_triangles.size(); }
+        // TriangleMesh::materialID of the mesh the tree was built from.
+        int materialID() const { return m_materialID; }
+
+        ClosestHit closestPoint(const float3 &p, float maxDistance = INFINITY) const;
+
+        // Nearest two-sided hit along dir with t in [0, maxDistance].
+        RayHit intersect(const float3 &origin, const float3 &dir, float maxDistance = INFINITY) const;
+
+        // Nearest hit along +dir or -dir; the returned t carries the side (negative = against dir).
+        RayHit intersectBothWays(const float3 &origin, const float3 &dir, float maxDistance = INFINITY) const;
+
+        // Bounds of all source triangles (empty box when nothing is built).
+        float3 lower() const { return m_lower; }
+        float3 upper() const { return m_upper; }
+        float diagonal() const { return empty() ? 0.0f : length(m_upper - m_lower); }
+
+        const cuBQL::bvh3f &tree() const { return m_bvh; }
+        // Triangles in BVH primitive order (see build with a subset).
+        const std::vector<cuBQL::Triangle> &triangles() const { return m_triangles; }
+
+    private:
+        void buildPrims(const TriangleMesh &mesh, size_t numTri);
+        void buildLevels();
+        int meshTriangle(uint32_t prim) const { return static_cast<int>(m_subset.empty() ? prim : m_subset[prim]); }
+
+        std::vector<cuBQL::Triangle> m_triangles;
+        cuBQL::bvh3f m_bvh{};
+        bool m_built = false;
+        std::vector<uint32_t> m_subset; // prim -> mesh triangle (empty = identity)
+        size_t m_indexCount = 0;        // mesh.index.size() at build time
+        float m_builtCost = 0.0f;
+        int m_materialID = -1;
+        std::vector<uint32_t> m_levelOffsets; // nodes of depth d: m_levelNodes[m_levelOffsets[d], m_levelOffsets[d + 1])
+        std::vector<uint32_t> m_levelNodes;
+        float3 m_lower = {INFINITY, INFINITY, INFINITY};
+        float3 m_upper = {-INFINITY, -INFINITY, -INFINITY};
+    };
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+#include "TriangleMesh.h"
+
+namespace SPIN
+{
+    enum class NormalWeighting
+    {
+        AREA,  // face normals weighted by triangle area
+        ANGLE  // face normals weighted by the corner angle at the vertex
+    };
+
+    // Builds unit per-vertex normals in parallel by gathering the incident faces of each vertex
+    // (uses the mesh's cached MeshTopology).
+    // Vertices without non-degenerate incident faces get a zero normal.
+    std::vector<float3> computeVertexNormals(const TriangleMesh &mesh, NormalWeighting weighting = NormalWeighting::ANGLE);
+
+    // Same, for the listed vertices only (one normal per entry), e.g. the one-ring of an edit.
+    std::vector<float3> computeVertexNormals(const TriangleMesh &mesh, const std::vector<uint32_t> &vertices,
+                                             NormalWeighting weighting = NormalWeighting::ANGLE);
+
+    // Returns mesh.normal, generating it first when the mesh was loaded without normals.
+    const std::vector<float3> &requireVertexNormals(TriangleMesh &mesh, NormalWeighting weighting = NormalWeighting::ANGLE);
+
+    // Barycentric vertex areas: a third of the area of every incident triangle (parallel gather over
+    // the cached MeshTopology). They sum to the mesh area.
+    std::vector<float> computeVertexAreas(const TriangleMesh &mesh);
+}
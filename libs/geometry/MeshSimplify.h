@@ -0,0 +1,38 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "TriangleMesh.h"
+
+namespace SPIN
+{
+    struct SimplifiedMesh
+    {
+        TriangleMesh mesh;
+        std::vector<uint32_t> vertexMap; // input vertex -> output vertex
+    };
+
+    // Vertex clustering on a uniform grid with one quadric-optimal representative per occupied cell
+    // (Lindstrom 2000). Fully parallel and fast, but not topology preserving and positions only:
+    // meant for proxies and previews. The cell size is derived from the surface area so the result
+    // lands near targetTriangles.
+    SimplifiedMesh clusterSimplify(const TriangleMesh &mesh, size_t targetTriangles);
+
+    struct DecimateOptions
+    {
+        // Stop once the mesh has at most this many triangles (0 = bounded by maxError only).
+        size_t targetTriangles = 0;
+        // Reject collapses whose RMS distance to the original planes around them exceeds this.
+        float maxError = INFINITY;
+        // Open-boundary edges get perpendicular planes with this weight (0 = free boundaries).
+        float boundaryWeight = 100.0f;
+        // Each pass decimates the cells of a shifted grid in parallel; vertices on faces that span
+        // cells are locked for that pass.
+        int maxPasses = 8;
+    };
+
+    // Garland-Heckbert edge-collapse decimation in parallel over spatial cells. Collapses keep the
+    // mesh manifold where it was, reject normal flips and interpolate normals and texcoords along the
+    // collapsed edge. vertexMap gives the surviving output vertex of every input vertex.
+    SimplifiedMesh decimateMesh(const TriangleMesh &mesh, const DecimateOptions &options);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "TriangleMesh.h"
+
+namespace SPIN
+{
+    // Compressed-sparse-row adjacency of a triangle mesh.
+    // Lists for vertex v live in [offsets[v], offsets[v + 1]) and are sorted ascending.
+    struct MeshTopology
+    {
+        size_t numVertices = 0;
+        size_t numFaces = 0;
+
+        std::vector<uint32_t> vertexFaceOffsets;
+        std::vector<uint32_t> vertexFaces;
+
+        std::vector<uint32_t> vertexVertexOffsets;
+        std::vector<uint32_t> vertexVertices;
+
+        // Unique undirected edges (x < y), sorted, with the number of faces sharing each edge
+        // (1 = boundary, 2 = manifold interior, >2 = non-manifold).
+        std::vector<uint2> edges;
+        std::vector<uint32_t> edgeFaceCount;
+
+        uint32_t faceDegree(uint32_t v) const { return vertexFaceOffsets[v + 1] - vertexFaceOffsets[v]; }
+        const uint32_t *facesBegin(uint32_t v) const { return vertexFaces.data() + vertexFaceOffsets[v]; }
+        const uint32_t *facesEnd(uint32_t v) const { return vertexFaces.data() + vertexFaceOffsets[v + 1]; }
+
+        uint32_t vertexDegree(uint32_t v) const { return vertexVertexOffsets[v + 1] - vertexVertexOffsets[v]; }
+        const uint32_t *neighborsBegin(uint32_t v) const { return vertexVertices.data() + vertexVertexOffsets[v]; }
+        const uint32_t *neighborsEnd(uint32_t v) const { return vertexVertices.data() + vertexVertexOffsets[v + 1]; }
+
+        bool matches(const TriangleMesh &mesh) const
+        {
+            return numVertices == mesh.vertex.size() && numFaces == mesh.index.size();
+        }
+    };
+
+    // Builds the adjacency in parallel (radix sort of packed edge keys).
+    std::shared_ptr<const MeshTopology> buildMeshTopology(const TriangleMesh &mesh);
+
+    // Returns the topology cached on the mesh, building it on first use or when the cache is stale.
+    // Call mesh.invalidateCaches() after editing mesh.index in place.
+    std::shared_ptr<const MeshTopology> meshTopology(const TriangleMesh &mesh);
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <vector>
+#include "Affine.h"
+#include "TriangleMesh.h"
+
+namespace SPIN
+{
+    // Bulk transforms of vertex arrays, parallel over the worker pool. Each worker gathers blocks of
+    // points into x/y/z lanes so the matrix product runs as plain vectorizable loops.
+    // in and out may be the same array.
+
+    // out[i] = a.applyPoint(in[i]).
+    void transformPoints(const Affine &a, const float3 *in, float3 *out, size_t count);
+    inline void transformPoints(const Affine &a, std::vector<float3> &points) { transformPoints(a, points.data(), points.data(), points.size()); }
+
+    // Unit normals under a: the inverse transpose of its linear part, renormalized. Zero normals stay zero.
+    void transformNormals(const Affine &a, const float3 *in, float3 *out, size_t count);
+    inline void transformNormals(const Affine &a, std::vector<float3> &normals) { transformNormals(a, normals.data(), normals.data(), normals.size()); }
+
+    // Applies a to the vertices and normals of mesh in place.
+    void transformMesh(TriangleMesh &mesh, const Affine &a);
+    inline void transformMesh(TriangleMesh &mesh, const Transform_t &t) { transformMesh(mesh, toAffine(t)); }
+}
@@ -10,7 +10,8 @@ public:
 	quat rotation = {0,0,0,1};
 	float3 scale = {1,1,1};
 
-	void getTRS(float* trs);
+	// Row-major 3x4 matrix translation * rotation * scale.
+	void getTRS(float* trs) const;
 };
 
 class Object_t{
@@ -24,9 +25,9 @@ public:
 
 class Instance_t : public Transform_t {
 public:
-	Object_t* obj;
+	Object_t* obj = nullptr;
 
-	Instance_t* parent;
+	Instance_t* parent = nullptr; // world = parent's world * own TRS
 };
 
 class Scene {
@@ -0,0 +1,169 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace SPIN
+{
+    // Mergeable KLL quantile sketch (Karnin, Lang, Liberty 2016).
+    // Memory is O(k) regardless of the stream length; the normalized rank error of a single
+    // quantile query is below normalizedRankError() with 99% confidence.
+    // Exact mode keeps every value instead and answers with true order statistics (for validation).
+    class QuantileSketch
+    {
+    public:
+        explicit QuantileSketch(int k = 200, bool exact = false, uint64_t seed = 0x2545F4914F6CDD1Dull)
+            : m_k(std::max(8, k)), m_exact(exact), m_seed(seed)
+        {
+            m_levels.resize(1);
+            m_capacity = totalCapacity();
+        }
+
+        void add(float v)
+        {
+            if (!std::isfinite(v))
+                return;
+            m_levels[0].push_back(v);
+            ++m_n;
+            ++m_retained;
+            if (!m_exact && m_retained > m_capacity)
+                compress();
+        }
+
+        void merge(const QuantileSketch &o)
+        {
+            if (o.m_n == 0)
+                return;
+            // The result is exact only when both sides are.
+            m_exact = m_exact && o.m_exact;
+            if (m_levels.size() < o.m_levels.size())
+                m_levels.resize(o.m_levels.size());
+            for (size_t h = 0; h < o.m_levels.size(); ++h)
+                m_levels[h].insert(m_levels[h].end(), o.m_levels[h].begin(), o.m_levels[h].end());
+            m_n += o.m_n;
+            m_retained += o.m_retained;
+            m_capacity = totalCapacity();
+            if (!m_exact)
+                compress();
+        }
+
+        // Value at normalized rank q in [0, 1]; 0 when the sketch is empty.
+        float quantile(double q) const
+        {
+            if (m_n == 0)
+                return 0.0f;
+            q = std::clamp(q, 0.0, 1.0);
+
+            std::vector<std::pair<float, uint64_t>> items;
+            items.reserve(retained());
+            for (size_t h = 0; h < m_levels.size(); ++h)
+                for (float v : m_levels[h])
+                    items.emplace_back(v, uint64_t(1) << h);
+
+            if (m_exact)
+            {
+                const size_t rank = static_cast<size_t>(q * static_cast<double>(items.size() - 1) + 0.5);
+                std::nth_element(items.begin(), items.begin() + rank, items.end(),
+                                 [](const auto &a, const auto &b) { return a.first < b.first; });
+                return items[rank].first;
+            }
+
+            std::sort(items.begin(), items.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+            uint64_t total = 0;
+            for (const auto &it : items)
+                total += it.second;
+            const double target = q * static_cast<double>(total);
+            uint64_t cumulative = 0;
+            for (const auto &it : items)
+            {
+                cumulative += it.second;
+                if (static_cast<double>(cumulative) >= target)
+                    return it.first;
+            }
+            return items.back().first;
+        }
+
+        uint64_t count() const { return m_n; }
+        bool exact() const { return m_exact; }
+        int k() const { return m_k; }
+
+        size_t retained() const { return m_retained; }
+
+        // 99%-confidence bound on |estimated rank - true rank| / n (0 in exact mode).
+        double normalizedRankError() const
+        {
+            return m_exact ? 0.0 : 2.296 / std::pow(static_cast<double>(m_k), 0.9723);
+        }
+
+    private:
+        size_t levelCapacity(size_t level) const { return m_levelCapacity[level]; }
+
+        // Capacities shrink geometrically (factor 2/3) from the top level down, with a floor of 8
+        // so the lowest levels do not compact on nearly every insertion.
+        size_t totalCapacity()
+        {
+            m_levelCapacity.resize(m_levels.size());
+            size_t c = 0;
+            for (size_t h = 0; h < m_levels.size(); ++h)
+            {
+                const size_t depth = m_levels.size() - 1 - h;
+                const double cap = std::ceil(static_cast<double>(m_k) * std::pow(2.0 / 3.0, static_cast<double>(depth)));
+                m_levelCapacity[h] = std::max<size_t>(8, static_cast<size_t>(cap));
+                c += m_levelCapacity[h];
+            }
+            return c;
+        }
+
+        bool coin(size_t level)
+        {
+            // splitmix64 over (seed, stream length, level): deterministic for a given input order.
+            uint64_t z = m_seed + 0x9E3779B97F4A7C15ull * (m_n + 1) + level;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return ((z ^ (z >> 31)) & 1) != 0;
+        }
+
+        void compress()
+        {
+            while (m_retained > m_capacity)
+            {
+                size_t h = 0;
+                while (h < m_levels.size() && m_levels[h].size() < levelCapacity(h))
+                    ++h;
+                if (h == m_levels.size())
+                    h = m_levels.size() - 1;
+                if (h + 1 == m_levels.size())
+                {
+                    m_levels.emplace_back();
+                    m_capacity = totalCapacity();
+                }
+
+                // Sort the level, promote every other item (random offset) with doubled weight.
+                std::vector<float> &level = m_levels[h];
+                std::sort(level.begin(), level.end());
+                const bool oddCount = (level.size() % 2) != 0;
+                const float leftover = oddCount ? level.back() : 0.0f;
+                const size_t pairs = level.size() / 2;
+                const size_t offset = coin(h) ? 1 : 0;
+                std::vector<float> &next = m_levels[h + 1];
+                for (size_t i = 0; i < pairs; ++i)
+                    next.push_back(level[2 * i + offset]);
+                level.clear();
+                if (oddCount)
+                    level.push_back(leftover);
+                m_retained -= pairs;
+            }
+        }
+
+        int m_k;
+        bool m_exact;
+        uint64_t m_seed;
+        uint64_t m_n = 0;
+        size_t m_retained = 0;
+        size_t m_capacity = 0;
+        std::vector<std::vector<float>> m_levels;
+        std::vector<size_t> m_levelCapacity;
+    };
+}
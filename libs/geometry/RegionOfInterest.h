@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "TriangleMesh.h"
+#include "Affine.h"
+
+namespace SPIN
+{
+    // Restricts a deviation run to part of the target mesh.
+    struct RegionOfInterest
+    {
+        enum class Type
+        {
+            NONE,         // whole target
+            BOX,          // axis-aligned box [boxMin, boxMax]
+            ORIENTED_BOX, // center + orthonormal axes scaled by halfExtents
+            VERTICES      // explicit target vertex indices
+        };
+
+        Type type = Type::NONE;
+
+        float3 boxMin = {0, 0, 0};
+        float3 boxMax = {0, 0, 0};
+
+        float3 center = {0, 0, 0};
+        float3 axes[3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+        float3 halfExtents = {0, 0, 0};
+
+        std::vector<uint32_t> vertices;
+
+        static RegionOfInterest box(const float3 &lo, const float3 &hi)
+        {
+            RegionOfInterest roi;
+            roi.type = Type::BOX;
+            roi.boxMin = lo;
+            roi.boxMax = hi;
+            return roi;
+        }
+
+        static RegionOfInterest orientedBox(const float3 &c, const float3 &x, const float3 &y, const float3 &z, const float3 &half)
+        {
+            RegionOfInterest roi;
+            roi.type = Type::ORIENTED_BOX;
+            roi.center = c;
+            roi.axes[0] = x;
+            roi.axes[1] = y;
+            roi.axes[2] = z;
+            roi.halfExtents = half;
+            return roi;
+        }
+
+        static RegionOfInterest vertexList(std::vector<uint32_t> ids)
+        {
+            RegionOfInterest roi;
+            roi.type = Type::VERTICES;
+            roi.vertices = std::move(ids);
+            return roi;
+        }
+
+        // Geometric containment for BOX / ORIENTED_BOX (always true for NONE and VERTICES).
+        bool contains(const float3 &p) const
+        {
+            switch (type)
+            {
+            case Type::BOX:
+                return p.x >= boxMin.x && p.y >= boxMin.y && p.z >= boxMin.z &&
+                       p.x <= boxMax.x && p.y <= boxMax.y && p.z <= boxMax.z;
+            case Type::ORIENTED_BOX:
+            {
+                const float3 d = p - center;
+                return std::fabs(dot(d, axes[0])) <= halfExtents.x &&
+                       std::fabs(dot(d, axes[1])) <= halfExtents.y &&
+                       std::fabs(dot(d, axes[2])) <= halfExtents.z;
+            }
+            default:
+                return true;
+            }
+        }
+    };
+
+    // Target vertices covered by the ROI, ascending (all vertices for Type::NONE).
+    std::vector<uint32_t> selectRoiVertices(const TriangleMesh &target, const RegionOfInterest &roi);
+
+    // Source triangles whose bounds overlap [lo, hi], ascending.
+    std::vector<uint32_t> cullTriangles(const TriangleMesh &source, const float3 &lo, const float3 &hi);
+
+    // Conservative query box for closest-point search from the given target vertices:
+    // every closest source point lies inside it, so triangles outside can be culled before the BVH build.
+    // maxDistance bounds the search radius when finite. Queries are mapped by targetToSource first; the box
+    // and maxDistance are in source coordinates.
+    void closestPointCullBox(const TriangleMesh &source, const TriangleMesh &target, const std::vector<uint32_t> &queries,
+                             float maxDistance, float3 &lo, float3 &hi, const Affine &targetToSource = Affine::identity());
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include "Affine.h"
+#include "MeshTransform.h"
+#include "TriangleMesh.h"
+
+namespace SPIN
+{
+    class HostTriangleBVH;
+
+    struct IcpOptions
+    {
+        int maxIterations = 50;
+        // Target vertices used per iteration (stratified over the vertex order; 0 = all).
+        size_t maxSamples = 20000;
+        // Fraction of the correspondences with the largest distances dropped every iteration.
+        float trimFraction = 0.1f;
+        // Correspondences farther apart than this are rejected outright.
+        float maxCorrespondenceDistance = INFINITY;
+        // Converged once an update rotates by less than this (radians) and moves by less than
+        // translationTolerance times the source diagonal.
+        float rotationTolerance = 1e-5f;
+        float translationTolerance = 1e-6f;
+    };
+
+    struct IcpResult
+    {
+        Affine transform;   // maps the target onto the source
+        float rms = 0.0f;   // point-to-plane RMS over the kept correspondences of the last iteration
+        size_t inliers = 0; // kept correspondences of the last iteration
+        int iterations = 0;
+        bool converged = false;
+
+        Transform_t transformTRS() const { return toTransform(transform); }
+    };
+
+    // Rigid point-to-plane ICP of the target vertices against the source triangles. Correspondences are
+    // closest points from the prebuilt source BVH, queried in parallel; the source face normal at each
+    // hit gives its plane. Starts from initial (e.g. a coarse registration).
+    IcpResult alignIcp(const HostTriangleBVH &sourceBVH, const TriangleMesh &source, const TriangleMesh &target,
+                       const IcpOptions &options = {}, const Affine &initial = Affine::identity());
+
+    struct GlobalRegistrationOptions
+    {
+        // Voxel edge for downsampling both meshes; 0 picks it from the source area so the source keeps
+        // about targetPoints points.
+        float voxelSize = 0.0f;
+        size_t targetPoints = 3000;
+        // Descriptor neighbourhood radius and RANSAC inlier distance, in voxels.
+        float featureRadius = 5.0f;
+        float inlierDistance = 1.5f;
+        // Keep only descriptor matches that are nearest neighbours in both directions.
+        bool mutualFilter = true;
+        int ransacIterations = 20000;
+        // Sampled triples whose source and target edge lengths differ by more than this ratio are skipped.
+        float edgeLengthRatio = 0.9f;
+        uint32_t seed = 1;
+    };
+
+    struct GlobalRegistrationResult
+    {
+        Affine transform; // maps the target onto the source; seeds alignIcp
+        size_t sourcePoints = 0, targetPoints = 0;
+        size_t correspondences = 0; // descriptor matches fed to RANSAC
+        size_t inliers = 0;         // matches within the inlier distance under transform
+        float inlierRms = 0.0f;
+
+        float fitness() const { return correspondences > 0 ? static_cast<float>(inliers) / static_cast<float>(correspondences) : 0.0f; }
+        Transform_t transformTRS() const { return toTransform(transform); }
+    };
+
+    // Coarse rigid registration for arbitrary initial poses: both meshes are voxel-downsampled, FPFH
+    // descriptors (Rusu 2009) are built in parallel from the voxel normals, matched, and a RANSAC over
+    // matched triples picks the pose with the most inliers, refined on those inliers.
+    // Cost depends on the downsampled sets, not on the input vertex counts.
+    GlobalRegistrationResult registerGlobal(const TriangleMesh &source, const TriangleMesh &target,
+                                            const GlobalRegistrationOptions &options = {});
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "Affine.h"
+#include "HostTriangleBVH.h"
+#include "Object_t.h"
+
+namespace SPIN
+{
+    // World matrix of every instance in scene.hierarchy (same order): its TRS after its parents' world
+    // matrices. Parents outside the list are followed too; each chain is evaluated once.
+    // Throws std::invalid_argument on a parent cycle.
+    std::vector<Affine> flattenScene(const Scene &scene);
+
+    // Every placed mesh of the scene copied into one world-space mesh (for the device path and export),
+    // with the bulk transforms of MeshTransform.h. Normals and texcoords are kept when all meshes have them.
+    // triangleMaterials receives the materialID of every merged triangle's mesh (see
+    // DeviationOptions::sourceTriangleMaterials).
+    TriangleMesh mergeScene(const Scene &scene, std::vector<int> *triangleMaterials = nullptr);
+
+    // One placed mesh of a flattened scene.
+    struct SceneInstance
+    {
+        const Instance_t *instance = nullptr;
+        const TriangleMesh *mesh = nullptr;
+        uint32_t blas = 0; // bottom-level BVH shared by every instance of the mesh
+        Affine world;
+        Affine worldInverse;
+        float scale = 1.0f; // uniform scale of world
+    };
+
+    // Two-level acceleration structure over a Scene: one bottom-level HostTriangleBVH per distinct mesh of
+    // the referenced Object_t models, shared across instances, and a top-level BVH over the world bounds
+    // of every (instance, mesh) pair. Queries enter an instance through its inverse world matrix, so
+    // instance transforms must be rigid up to a uniform scale (build throws std::invalid_argument otherwise).
+    // Hits report the instance (index into instances()) and the triangle of its mesh.
+    class HostSceneBVH
+    {
+    public:
+        HostSceneBVH() = default;
+        explicit HostSceneBVH(const Scene &scene) { build(scene); }
+        ~HostSceneBVH() { release(); }
+
+        HostSceneBVH(const HostSceneBVH &) = delete;
+        HostSceneBVH &operator=(const HostSceneBVH &) = delete;
+
+        void build(const Scene &scene);
+        void release();
+
+        bool empty() const { return m_instances.empty(); }
+        const std::vector<SceneInstance> &instances() const { return m_instances; }
+        size_t meshCount() const { return m_blas.size(); }
+
+        ClosestHit closestPoint(const float3 &p, float maxDistance = INFINITY) const;
+        RayHit intersect(const float3 &origin, const float3 &dir, float maxDistance = INFINITY) const;
+        RayHit intersectBothWays(const float3 &origin, const float3 &dir, float maxDistance = INFINITY) const;
+
+        float3 lower() const { return m_lower; }
+        float3 upper() const { return m_upper; }
+        float diagonal() const { return empty() ? 0.0f : length(m_upper - m_lower); }
+
+    private:
+        std::vector<std::unique_ptr<HostTriangleBVH>> m_blas;
+        std::vector<SceneInstance> m_instances;
+        cuBQL::bvh3f m_tlas{};
+        bool m_built = false;
+        float3 m_lower = {INFINITY, INFINITY, INFINITY};
+        float3 m_upper = {-INFINITY, -INFINITY, -INFINITY};
+    };
+}
@@ -1,8 +1,15 @@
 #pragma once
+#include <memory>
 #include <vector>
 #include <string>
 #include "3rdParty/helper_math.h"
 
+namespace SPIN
+{
+    struct MeshTopology;
+    struct EdgeLengthStats;
+}
+
 class Material_t {
 public:
     float3 ambient = { 1,1,1 };
@@ -25,6 +32,31 @@ public:
 
     int materialID{ -1 };
     int materialTextureID{ -1 };
+
+    // Lazily built derived data shared by analyses (see MeshTopology.h, EdgeStatistics.h).
+    mutable std::shared_ptr<const SPIN::MeshTopology> topologyCache;
+    mutable std::shared_ptr<const SPIN::EdgeLengthStats> edgeStatsCache;
+
+    // Drop derived data after editing vertex/index in place.
+    void invalidateCaches() const
+    {
+        topologyCache.reset();
+        edgeStatsCache.reset();
+    }
+
+    // Vertex ranges [x, y) moved since the last incremental deviation update (see updateDeviation).
+    // Appended vertices are picked up without marking; index edits still need invalidateCaches().
+    std::vector<uint2> dirtyRanges;
+
+    void markDirty(uint32_t begin, uint32_t end)
+    {
+        if (begin < end)
+            dirtyRanges.push_back(make_uint2(begin, end));
+        // Positions changed, the connectivity did not: only the edge statistics are stale.
+        edgeStatsCache.reset();
+    }
+    void markDirty(uint32_t vertexIdx) { markDirty(vertexIdx, vertexIdx + 1); }
+    void clearDirty() { dirtyRanges.clear(); }
 };
 
 
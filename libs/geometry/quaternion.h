@@ -3,28 +3,56 @@
 #include <memory>
 typedef float4 quat;
 
+// Rotation matrix of a unit quaternion, stored column by column.
 void quat2rom(quat q, float* rom);
+// Inverse of quat2rom for a proper rotation in the same layout; returns a unit quaternion with w >= 0.
+quat rom2quat(const float* rom);
 
 #ifdef QUATERNION_IMPLEMENTATION
 void quat2rom(quat q, float* rom) {
-	float3 rotMat[3];
+	// Column by column: rom[3 * j + i] = R(i, j).
+	const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
 
-	rotMat[0] = make_float3(1 - 2 * (q.y * q.y + q.z * q.z),
-		2 * (q.x * q.y - q.w * q.z),
-		2 * (q.x * q.z + q.w * q.y));
-	rotMat[1] = make_float3(2 * (q.x * q.y + q.w * q.z),
-		1 - 2 * (q.x * q.x + q.z * q.z),
-		2 * (q.y * q.z - q.w * q.x));
-	rotMat[2] = make_float3(2 * (q.x * q.z - q.w * q.y),
-		2 * (q.y * q.z + q.w * q.x),
-		1 - 2 * (q.x * q.x + q.y * q.y));
+	rom[0] = 1 - 2 * (yy + zz);
+	rom[1] = 2 * (xy + wz);
+	rom[2] = 2 * (xz - wy);
+	rom[3] = 2 * (xy - wz);
+	rom[4] = 1 - 2 * (xx + zz);
+	rom[5] = 2 * (yz + wx);
+	rom[6] = 2 * (xz + wy);
+	rom[7] = 2 * (yz - wx);
+	rom[8] = 1 - 2 * (xx + yy);
+}
 
-	float _rom[9] = {
-		rotMat[0].x, rotMat[1].x, rotMat[2].x,
-		rotMat[0].y, rotMat[1].y, rotMat[2].y,
-		rotMat[0].z, rotMat[1].z, rotMat[2].z
-	};
+quat rom2quat(const float* rom) {
+	// rom holds the rotation column by column (see quat2rom): R(i, j) = rom[3 * j + i].
+	const float r00 = rom[0], r10 = rom[1], r20 = rom[2];
+	const float r01 = rom[3], r11 = rom[4], r21 = rom[5];
+	const float r02 = rom[6], r12 = rom[7], r22 = rom[8];
 
-	memcpy(rom, _rom, sizeof(float) * 9);
+	// Shepperd: divide by the largest of the four candidates for stability.
+	quat q;
+	const float trace = r00 + r11 + r22;
+	if (trace > 0) {
+		const float s = sqrtf(trace + 1) * 2;
+		q = make_float4((r21 - r12) / s, (r02 - r20) / s, (r10 - r01) / s, s / 4);
+	}
+	else if (r00 > r11 && r00 > r22) {
+		const float s = sqrtf(1 + r00 - r11 - r22) * 2;
+		q = make_float4(s / 4, (r01 + r10) / s, (r02 + r20) / s, (r21 - r12) / s);
+	}
+	else if (r11 > r22) {
+		const float s = sqrtf(1 + r11 - r00 - r22) * 2;
+		q = make_float4((r01 + r10) / s, s / 4, (r12 + r21) / s, (r02 - r20) / s);
+	}
+	else {
+		const float s = sqrtf(1 + r22 - r00 - r11) * 2;
+		q = make_float4((r02 + r20) / s, (r12 + r21) / s, s / 4, (r10 - r01) / s);
+	}
+	if (q.w < 0)
+		q = make_float4(-q.x, -q.y, -q.z, -q.w);
+	return normalize(q);
 }
-#endif
\ No newline at end of file
+#endif